@@ -0,0 +1,115 @@
+# Reports the code size and worst case stack usage of the minimal profile, and
+# fails when either exceeds its limit.
+#
+# Invoked through the footprint target with:
+#
+#   LIBRARY    the built library
+#   OBJECTS    the directory holding the .ci files from -fcallgraph-info=su
+#   SIZE       the size program
+#   MAX_TEXT   the limit for the text section in bytes
+#   MAX_STACK  the limit for the deepest call chain in bytes
+#
+# Stack usage is the largest sum of frames along any call chain in the call
+# graphs GCC emits. Functions outside the library, such as read, are not
+# counted.
+
+execute_process (
+    COMMAND ${SIZE} -t ${LIBRARY}
+    OUTPUT_VARIABLE sizeOutput
+    RESULT_VARIABLE sizeResult
+)
+
+if (NOT sizeResult EQUAL 0)
+    message (FATAL_ERROR "footprint: could not run ${SIZE} on ${LIBRARY}")
+endif()
+
+string (REGEX MATCH "[ \t]*([0-9]+)[^\n]*\\(TOTALS\\)" _ "${sizeOutput}")
+set (text ${CMAKE_MATCH_1})
+
+file (GLOB graphs "${OBJECTS}/*.ci")
+
+if (NOT graphs)
+    message (FATAL_ERROR "footprint: no call graphs found in ${OBJECTS}")
+endif()
+
+set (functions "")
+
+# graph titles are turned into identifiers so they can name variables
+foreach (graph ${graphs})
+    file (STRINGS ${graph} lines)
+
+    foreach (line ${lines})
+        if (line MATCHES "^node: { title: \"([^\"]+)\" label: \"([^\\\"]+)\\\\n[^\"]*\\\\n([0-9]+) bytes")
+            string (MAKE_C_IDENTIFIER "${CMAKE_MATCH_1}" function)
+            set (frame_${function} ${CMAKE_MATCH_3})
+            set (name_${function} ${CMAKE_MATCH_2})
+            list (APPEND functions ${function})
+        elseif (line MATCHES "^edge: { sourcename: \"([^\"]+)\" targetname: \"([^\"]+)\"")
+            string (MAKE_C_IDENTIFIER "${CMAKE_MATCH_1}" caller)
+            string (MAKE_C_IDENTIFIER "${CMAKE_MATCH_2}" callee)
+            list (APPEND calls_${caller} ${callee})
+        endif()
+    endforeach()
+endforeach()
+
+# depth_<function> is the deepest stack usage starting at that function
+function (footprint_depth name)
+    if (DEFINED depth_${name})
+        return ()
+    endif()
+
+    set (frame 0)
+
+    if (DEFINED frame_${name})
+        set (frame ${frame_${name}})
+    endif()
+
+    set (deepest 0)
+    set (deepestPath "")
+
+    if (DEFINED calls_${name})
+        list (REMOVE_DUPLICATES calls_${name})
+
+        foreach (callee ${calls_${name}})
+            footprint_depth (${callee})
+
+            if (depth_${callee} GREATER deepest)
+                set (deepest ${depth_${callee}})
+                set (deepestPath ${path_${callee}})
+            endif()
+        endforeach()
+    endif()
+
+    math (EXPR depth "${frame} + ${deepest}")
+
+    set (depth_${name} ${depth} PARENT_SCOPE)
+    set (display ${name})
+
+    if (DEFINED name_${name})
+        set (display ${name_${name}})
+    endif()
+
+    set (path_${name} ${display} ${deepestPath} PARENT_SCOPE)
+endfunction()
+
+set (stack 0)
+set (stackPath "")
+
+foreach (function ${functions})
+    footprint_depth (${function})
+
+    if (depth_${function} GREATER stack)
+        set (stack ${depth_${function}})
+        set (stackPath ${path_${function}})
+    endif()
+endforeach()
+
+string (REPLACE ";" " -> " stackPath "${stackPath}")
+
+message ("footprint: text ${text} bytes (limit ${MAX_TEXT})")
+message ("footprint: stack ${stack} bytes (limit ${MAX_STACK})")
+message ("footprint: deepest ${stackPath}")
+
+if (text GREATER MAX_TEXT OR stack GREATER MAX_STACK)
+    message (FATAL_ERROR "footprint: the minimal profile grew past its limits")
+endif()
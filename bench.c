@@ -0,0 +1,543 @@
+/*
+BSD 3-Clause License
+
+Copyright (c) 2021, Harpo Roeder
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/*
+ * Throughput benchmarks for libmachineid. These rely on POSIX threads and
+ * clocks, and as such are not built on Windows.
+ *
+ * usage: bench [threads] [iterations]
+ */
+
+#define _POSIX_C_SOURCE 200112L
+
+#include "machineid.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef BENCH_LIBUUID
+#include <uuid/uuid.h>
+#endif
+
+#define BENCH_DEFAULT_THREADS 64
+#define BENCH_DEFAULT_ITERATIONS 2000
+#define BENCH_FINGERPRINT_RECORDS (1UL << 20)
+#define BENCH_FINGERPRINT_ROUNDS 8
+#define BENCH_TOKENS (1UL << 18)
+#define BENCH_TOKEN_KEYS 256
+#define BENCH_TOKEN_PAYLOAD_SIZE 48
+#define BENCH_TOKEN_SIZE (BENCH_TOKEN_PAYLOAD_SIZE + MACHINEID_TOKEN_TAG_SIZE)
+#define BENCH_PLACEMENT_DIGESTS (1UL << 16)
+#define BENCH_PLACEMENT_BUCKETS 1000
+#define BENCH_UUIDS (1UL << 18)
+
+struct bench_worker {
+    pthread_t thread;
+    unsigned long iterations;
+    unsigned long seed;
+    int failures;
+};
+
+static double
+bench_now()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+/*
+ * Both workers read a cached digest, so the only difference between them is
+ * whether that context is shared behind a lock or private to the thread.
+ */
+static pthread_mutex_t sharedLock = PTHREAD_MUTEX_INITIALIZER;
+static struct machineid_ctx sharedCtx;
+
+static void *
+bench_shared_worker(void *arg)
+{
+    struct bench_worker *worker;
+    unsigned char buffer[MACHINEID_UUID_SIZE];
+    enum machineid_error err;
+    unsigned long i;
+
+    worker = (struct bench_worker *)arg;
+
+    for (i = 0; i < worker->iterations; i++) {
+        pthread_mutex_lock(&sharedLock);
+        err = machineid_ctx_generate(&sharedCtx, buffer,
+            MACHINEID_FLAG_AS_UUID);
+        pthread_mutex_unlock(&sharedLock);
+
+        if (err != MACHINEID_ERROR_NONE && err != MACHINEID_ERROR_FALLBACK) {
+            worker->failures++;
+        }
+    }
+
+    return NULL;
+}
+
+static void *
+bench_ctx_worker(void *arg)
+{
+    struct bench_worker *worker;
+    struct machineid_ctx ctx;
+    unsigned char buffer[MACHINEID_UUID_SIZE];
+    enum machineid_error err;
+    unsigned long i;
+
+    worker = (struct bench_worker *)arg;
+
+    machineid_ctx_init(&ctx, worker->seed);
+
+    for (i = 0; i < worker->iterations; i++) {
+        err = machineid_ctx_generate(&ctx, buffer, MACHINEID_FLAG_AS_UUID);
+
+        if (err != MACHINEID_ERROR_NONE && err != MACHINEID_ERROR_FALLBACK) {
+            worker->failures++;
+        }
+    }
+
+    return NULL;
+}
+
+static int
+bench_run(const char *const name, void *(*routine)(void *),
+    const unsigned long threads, const unsigned long iterations)
+{
+    struct bench_worker *workers;
+    unsigned long i, started;
+    double start, elapsed;
+    int failures;
+
+    workers = calloc(threads, sizeof(*workers));
+
+    if (workers == NULL) {
+        return 1;
+    }
+
+    start = bench_now();
+
+    for (started = 0; started < threads; started++) {
+        workers[started].iterations = iterations;
+        workers[started].seed = started + 1;
+
+        if (pthread_create(&workers[started].thread, NULL, routine,
+            &workers[started]) != 0) {
+            break;
+        }
+    }
+
+    failures = 0;
+
+    /* threads already running still write into workers, join before free */
+    for (i = 0; i < started; i++) {
+        pthread_join(workers[i].thread, NULL);
+        failures += workers[i].failures;
+    }
+
+    if (started < threads) {
+        fprintf(stderr, "%s: could only start %lu of %lu threads\n", name,
+            started, threads);
+
+        free(workers);
+
+        return 1;
+    }
+
+    elapsed = bench_now() - start;
+
+    printf("%-26s threads=%-4lu calls=%-10lu %10.3f ms %14.0f calls/s\n",
+        name, threads, threads * iterations, elapsed * 1e3,
+        (double)(threads * iterations) / elapsed);
+
+    free(workers);
+
+    return failures != 0;
+}
+
+static int
+bench_fingerprint_match()
+{
+    struct machineid_fingerprint probe, *records;
+    unsigned char *scores;
+    unsigned long i, j;
+    size_t matches;
+    double start, elapsed, bytes;
+
+    records = malloc(BENCH_FINGERPRINT_RECORDS * sizeof(*records));
+    scores = malloc(BENCH_FINGERPRINT_RECORDS);
+
+    if (records == NULL || scores == NULL) {
+        free(records);
+        free(scores);
+
+        return 1;
+    }
+
+    machineid_fingerprint_generate(&probe);
+
+    probe.present = (1 << MACHINEID_COMPONENT_COUNT) - 1;
+
+    for (i = 0; i < BENCH_FINGERPRINT_RECORDS; i++) {
+        records[i] = probe;
+
+        for (j = 0; j < MACHINEID_COMPONENT_COUNT; j++) {
+            if ((i >> j) & 1) {
+                records[i].digests[j][0] ^= 0xFF;
+            }
+        }
+    }
+
+    matches = 0;
+
+    start = bench_now();
+
+    for (i = 0; i < BENCH_FINGERPRINT_ROUNDS; i++) {
+        matches += machineid_fingerprint_match_batch(&probe, records,
+            BENCH_FINGERPRINT_RECORDS, 3, scores);
+    }
+
+    elapsed = bench_now() - start;
+    bytes = (double)BENCH_FINGERPRINT_RECORDS * BENCH_FINGERPRINT_ROUNDS
+        * sizeof(*records);
+
+    printf("%-26s records=%-8lu matches=%-8lu %10.3f ms %11.2f GB/s\n",
+        "fingerprint_match_batch", BENCH_FINGERPRINT_RECORDS,
+        (unsigned long)(matches / BENCH_FINGERPRINT_ROUNDS), elapsed * 1e3,
+        bytes / elapsed / 1e9);
+
+    free(records);
+    free(scores);
+
+    return 0;
+}
+
+static int
+bench_token_verify()
+{
+    unsigned char digest[MACHINEID_HASH_SIZE], *keys, *storage, *results;
+    unsigned char payload[BENCH_TOKEN_PAYLOAD_SIZE];
+    struct machineid_token *tokens;
+    unsigned long i;
+    size_t single, batch;
+    double start, singleElapsed, batchElapsed;
+    int status;
+
+    keys = malloc(BENCH_TOKEN_KEYS * MACHINEID_TOKEN_KEY_SIZE);
+    storage = malloc(BENCH_TOKENS * BENCH_TOKEN_SIZE);
+    results = malloc(BENCH_TOKENS);
+    tokens = malloc(BENCH_TOKENS * sizeof(*tokens));
+
+    status = 1;
+
+    if (keys == NULL || storage == NULL || results == NULL
+        || tokens == NULL) {
+        goto done;
+    }
+
+    machineid_generate(digest, MACHINEID_FLAG_DEFAULT);
+
+    for (i = 0; i < BENCH_TOKEN_KEYS; i++) {
+        digest[0] = (unsigned char)i;
+
+        machineid_token_key(keys + i * MACHINEID_TOKEN_KEY_SIZE, digest,
+            (const unsigned char *)"bench", 5);
+    }
+
+    for (i = 0; i < BENCH_TOKENS; i++) {
+        memset(payload, (int)(i & 0xFF), sizeof(payload));
+        memcpy(payload, &i, sizeof(i));
+
+        tokens[i].key = keys + (i % BENCH_TOKEN_KEYS)
+            * MACHINEID_TOKEN_KEY_SIZE;
+        tokens[i].data = storage + i * BENCH_TOKEN_SIZE;
+        tokens[i].size = BENCH_TOKEN_SIZE;
+
+        machineid_token_issue(storage + i * BENCH_TOKEN_SIZE, tokens[i].key,
+            payload, sizeof(payload));
+    }
+
+    start = bench_now();
+
+    single = 0;
+
+    for (i = 0; i < BENCH_TOKENS; i++) {
+        single += machineid_token_verify(tokens[i].key, tokens[i].data,
+            tokens[i].size);
+    }
+
+    singleElapsed = bench_now() - start;
+
+    start = bench_now();
+
+    batch = machineid_token_verify_batch(tokens, BENCH_TOKENS, results);
+
+    batchElapsed = bench_now() - start;
+
+    printf("%-26s tokens=%-9lu valid=%-9lu %10.3f ms %14.0f tokens/s\n",
+        "token_verify", BENCH_TOKENS, (unsigned long)single,
+        singleElapsed * 1e3, BENCH_TOKENS / singleElapsed);
+    printf("%-26s tokens=%-9lu valid=%-9lu %10.3f ms %14.0f tokens/s\n",
+        "token_verify_batch", BENCH_TOKENS, (unsigned long)batch,
+        batchElapsed * 1e3, BENCH_TOKENS / batchElapsed);
+
+    status = single != BENCH_TOKENS || batch != BENCH_TOKENS;
+
+  done:
+    free(keys);
+    free(storage);
+    free(results);
+    free(tokens);
+
+    return status;
+}
+
+static void
+bench_placement_report(const char *const name, const double elapsed,
+    const unsigned long buckets)
+{
+    printf("%-26s digests=%-8lu buckets=%-6lu %10.3f ms %13.0f digests/s\n",
+        name, BENCH_PLACEMENT_DIGESTS, buckets, elapsed * 1e3,
+        BENCH_PLACEMENT_DIGESTS / elapsed);
+}
+
+static int
+bench_placement()
+{
+    struct machineid_bucket buckets[BENCH_PLACEMENT_BUCKETS];
+    unsigned char *digests;
+    unsigned long *placed, i, j;
+    size_t *chosen;
+    double start;
+    int status;
+
+    digests = malloc(BENCH_PLACEMENT_DIGESTS * MACHINEID_HASH_SIZE);
+    placed = malloc(BENCH_PLACEMENT_DIGESTS * sizeof(*placed));
+    chosen = malloc(BENCH_PLACEMENT_DIGESTS * sizeof(*chosen));
+
+    status = 1;
+
+    if (digests == NULL || placed == NULL || chosen == NULL) {
+        goto done;
+    }
+
+    for (i = 0; i < BENCH_PLACEMENT_DIGESTS * MACHINEID_HASH_SIZE; i++) {
+        digests[i] = (unsigned char)(rand() >> 4);
+    }
+
+    for (j = 0; j < BENCH_PLACEMENT_BUCKETS; j++) {
+        buckets[j].id = j;
+        buckets[j].weight = 1;
+    }
+
+    start = bench_now();
+    machineid_place_jump_batch(digests, BENCH_PLACEMENT_DIGESTS,
+        BENCH_PLACEMENT_BUCKETS, placed);
+    bench_placement_report("place_jump_batch", bench_now() - start,
+        BENCH_PLACEMENT_BUCKETS);
+
+    start = bench_now();
+    machineid_place_cohort_batch(digests, BENCH_PLACEMENT_DIGESTS, 1,
+        BENCH_PLACEMENT_BUCKETS, placed);
+    bench_placement_report("place_cohort_batch", bench_now() - start,
+        BENCH_PLACEMENT_BUCKETS);
+
+    /* the baseline most teams reimplement, reshuffles on resize */
+    start = bench_now();
+
+    for (i = 0; i < BENCH_PLACEMENT_DIGESTS; i++) {
+        placed[i] = ((unsigned long)digests[i * MACHINEID_HASH_SIZE] << 24
+            | (unsigned long)digests[i * MACHINEID_HASH_SIZE + 1] << 16
+            | (unsigned long)digests[i * MACHINEID_HASH_SIZE + 2] << 8
+            | (unsigned long)digests[i * MACHINEID_HASH_SIZE + 3])
+            % BENCH_PLACEMENT_BUCKETS;
+    }
+
+    bench_placement_report("modulo (baseline)", bench_now() - start,
+        BENCH_PLACEMENT_BUCKETS);
+
+    start = bench_now();
+    machineid_place_rendezvous_batch(digests, BENCH_PLACEMENT_DIGESTS,
+        buckets, BENCH_PLACEMENT_BUCKETS, chosen);
+    bench_placement_report("place_rendezvous (equal)", bench_now() - start,
+        BENCH_PLACEMENT_BUCKETS);
+
+    for (j = 0; j < BENCH_PLACEMENT_BUCKETS; j++) {
+        buckets[j].weight = 1 + (double)(j % 4);
+    }
+
+    start = bench_now();
+    machineid_place_rendezvous_batch(digests, BENCH_PLACEMENT_DIGESTS,
+        buckets, BENCH_PLACEMENT_BUCKETS, chosen);
+    bench_placement_report("place_rendezvous (weight)", bench_now() - start,
+        BENCH_PLACEMENT_BUCKETS);
+
+    status = 0;
+
+  done:
+    free(digests);
+    free(placed);
+    free(chosen);
+
+    return status;
+}
+
+static void
+bench_uuid_report(const char *const name, const double elapsed)
+{
+    printf("%-26s uuids=%-10lu %10.3f ms %13.0f uuids/s\n", name,
+        BENCH_UUIDS, elapsed * 1e3, BENCH_UUIDS / elapsed);
+}
+
+static int
+bench_random_uuid()
+{
+    static const char *const hex = "0123456789abcdef";
+    unsigned char *uuids, bytes[16], *out;
+    unsigned long i, j;
+    double start;
+    int status;
+
+    uuids = malloc(BENCH_UUIDS * MACHINEID_UUID_SIZE);
+
+    if (uuids == NULL) {
+        return 1;
+    }
+
+    status = 0;
+
+    start = bench_now();
+    status |= machineid_random_uuid_fill(uuids, BENCH_UUIDS)
+        != MACHINEID_ERROR_NONE;
+    bench_uuid_report("random_uuid_fill (bulk)", bench_now() - start);
+
+    start = bench_now();
+
+    for (i = 0; i < BENCH_UUIDS; i++) {
+        status |= machineid_random_uuid_fill(
+            uuids + i * MACHINEID_UUID_SIZE, 1) != MACHINEID_ERROR_NONE;
+    }
+
+    bench_uuid_report("random_uuid_fill (single)", bench_now() - start);
+
+    /* the byte at a time rand loop previously used for random bytes */
+    start = bench_now();
+
+    for (i = 0; i < BENCH_UUIDS; i++) {
+        for (j = 0; j < 16; j++) {
+            bytes[j] = (unsigned char)rand();
+        }
+
+        bytes[6] = (bytes[6] & 0x0F) | 0x40;
+        bytes[8] = (bytes[8] & 0x3F) | 0x80;
+
+        out = uuids + i * MACHINEID_UUID_SIZE;
+
+        for (j = 0; j < 16; j++) {
+            if (j == 4 || j == 6 || j == 8 || j == 10) {
+                *out++ = '-';
+            }
+
+            *out++ = hex[bytes[j] >> 4];
+            *out++ = hex[bytes[j] & 0xF];
+        }
+    }
+
+    bench_uuid_report("per-byte rand (baseline)", bench_now() - start);
+
+#ifdef BENCH_LIBUUID
+    {
+        uuid_t uuid;
+        char text[MACHINEID_UUID_SIZE + 1];
+
+        start = bench_now();
+
+        for (i = 0; i < BENCH_UUIDS; i++) {
+            uuid_generate_random(uuid);
+            uuid_unparse_lower(uuid, text);
+            memcpy(uuids + i * MACHINEID_UUID_SIZE, text,
+                MACHINEID_UUID_SIZE);
+        }
+
+        bench_uuid_report("libuuid", bench_now() - start);
+    }
+#endif
+
+    free(uuids);
+
+    return status;
+}
+
+int
+main(int argc, char **argv)
+{
+    unsigned long threads, iterations;
+    int status;
+
+    threads = BENCH_DEFAULT_THREADS;
+    iterations = BENCH_DEFAULT_ITERATIONS;
+
+    if (argc > 1) {
+        threads = strtoul(argv[1], NULL, 10);
+    }
+
+    if (argc > 2) {
+        iterations = strtoul(argv[2], NULL, 10);
+    }
+
+    if (threads == 0 || iterations == 0) {
+        fprintf(stderr, "usage: %s [threads] [iterations]\n", argv[0]);
+
+        return 1;
+    }
+
+    status = 0;
+
+    machineid_ctx_init(&sharedCtx, 1);
+
+    status |= bench_run("ctx_generate (shared+lock)", bench_shared_worker,
+        threads, iterations);
+    status |= bench_run("ctx_generate (per-thread)", bench_ctx_worker,
+        threads, iterations);
+    status |= bench_fingerprint_match();
+    status |= bench_token_verify();
+    status |= bench_placement();
+    status |= bench_random_uuid();
+
+    return status;
+}
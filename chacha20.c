@@ -0,0 +1,104 @@
+/*
+BSD 3-Clause License
+
+Copyright (c) 2021, Harpo Roeder
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/*
+ * The ChaCha20 block function from RFC 8439, used for the random UUID
+ * streams in machineid.c.
+ */
+
+#include <string.h>
+
+#include "chacha20.h"
+
+#define CHACHA20_ROTL32(x, n) \
+    ((uint32_t)(((x) << (n)) | ((x) >> (32 - (n)))))
+
+#define CHACHA20_QUARTER_ROUND(a, b, c, d) \
+    a += b; d ^= a; d = CHACHA20_ROTL32(d, 16); \
+    c += d; b ^= c; b = CHACHA20_ROTL32(b, 12); \
+    a += b; d ^= a; d = CHACHA20_ROTL32(d, 8); \
+    c += d; b ^= c; b = CHACHA20_ROTL32(b, 7)
+
+uint32_t
+chacha20_load32(const unsigned char *const bytes)
+{
+    return (uint32_t)bytes[0] | (uint32_t)bytes[1] << 8
+        | (uint32_t)bytes[2] << 16 | (uint32_t)bytes[3] << 24;
+}
+
+static void
+chacha20_store32(unsigned char *const bytes, const uint32_t word)
+{
+    bytes[0] = (unsigned char)word;
+    bytes[1] = (unsigned char)(word >> 8);
+    bytes[2] = (unsigned char)(word >> 16);
+    bytes[3] = (unsigned char)(word >> 24);
+}
+
+void
+chacha20_block(unsigned char *const outputBuffer,
+    const uint32_t key[8], const uint32_t counter, const uint32_t nonce[3])
+{
+    uint32_t input[16], x[16];
+    unsigned int i;
+
+    input[0] = 0x61707865;
+    input[1] = 0x3320646e;
+    input[2] = 0x79622d32;
+    input[3] = 0x6b206574;
+
+    for (i = 0; i < 8; i++) {
+        input[4 + i] = key[i];
+    }
+
+    input[12] = counter;
+    input[13] = nonce[0];
+    input[14] = nonce[1];
+    input[15] = nonce[2];
+
+    memcpy(x, input, sizeof(x));
+
+    for (i = 0; i < 10; i++) {
+        CHACHA20_QUARTER_ROUND(x[0], x[4], x[8], x[12]);
+        CHACHA20_QUARTER_ROUND(x[1], x[5], x[9], x[13]);
+        CHACHA20_QUARTER_ROUND(x[2], x[6], x[10], x[14]);
+        CHACHA20_QUARTER_ROUND(x[3], x[7], x[11], x[15]);
+        CHACHA20_QUARTER_ROUND(x[0], x[5], x[10], x[15]);
+        CHACHA20_QUARTER_ROUND(x[1], x[6], x[11], x[12]);
+        CHACHA20_QUARTER_ROUND(x[2], x[7], x[8], x[13]);
+        CHACHA20_QUARTER_ROUND(x[3], x[4], x[9], x[14]);
+    }
+
+    for (i = 0; i < 16; i++) {
+        chacha20_store32(outputBuffer + i * 4, x[i] + input[i]);
+    }
+}
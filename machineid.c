@@ -30,7 +30,19 @@ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
 OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
+#if defined(__linux__) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#ifdef MACHINEID_MINIMAL
+#ifndef MACHINEID_NO_THREADS
+#define MACHINEID_NO_THREADS
+#endif
+#else
 #include <stdio.h>
+#include <stdint.h>
+#endif
+
 #include <string.h>
 #include <stddef.h>
 
@@ -46,13 +58,10 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <IOKit/IOKitLib.h>
 #endif
 
-#ifdef MACHINEID_USE_SODIUM
-#include <sodium.h>
-#include <openssl/rand.h>
-#elif MACHINEID_USE_OPENSSL
-#include <openssl/sha.h>
-#else
 #include "sha256.h"
+
+#ifndef MACHINEID_MINIMAL
+#include "chacha20.h"
 #endif
 
 #ifdef __OpenBSD__
@@ -60,6 +69,58 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <sys/sysctl.h>
 #endif
 
+#if defined(__linux__) && !defined(MACHINEID_MINIMAL)
+#include <dirent.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+#endif
+
+#if defined(MACHINEID_MINIMAL) && (defined(__linux__) \
+    || defined(__FreeBSD__) || defined(__OpenBSD__))
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+/* descriptors must not leak into children exec'd by other threads */
+#ifdef O_CLOEXEC
+#define MACHINEID_O_CLOEXEC O_CLOEXEC
+#else
+#define MACHINEID_O_CLOEXEC 0
+#endif
+#endif
+
+#if !defined(MACHINEID_NO_THREADS) && !defined(_WIN32) \
+    && (defined(__unix__) || defined(__APPLE__))
+#include <pthread.h>
+#include <time.h>
+#define MACHINEID_PTHREADS
+#elif !defined(MACHINEID_NO_THREADS) && defined(_WIN32)
+#define MACHINEID_WIN32_THREADS
+#endif
+
+#if !defined(MACHINEID_MINIMAL) && !defined(_WIN32) \
+    && (defined(__unix__) || defined(__APPLE__))
+#include <dlfcn.h>
+#define MACHINEID_DLOPEN
+#elif !defined(MACHINEID_MINIMAL) && defined(_WIN32)
+#define MACHINEID_DLOPEN
+#endif
+
+#if !defined(MACHINEID_MINIMAL) && defined(__linux__) \
+    && defined(__GLIBC__) \
+    && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 25))
+#include <errno.h>
+#include <sys/random.h>
+#define MACHINEID_GETRANDOM
+#endif
+
+#if !defined(MACHINEID_MINIMAL) && defined(MACHINEID_NO_THREADS) \
+    && !defined(_WIN32) && (defined(__unix__) || defined(__APPLE__))
+#include <unistd.h>
+#define MACHINEID_GETPID
+#endif
+
 #include "machineid.h"
 
 static void machineid_bin_to_hex(unsigned char *const outputBuffer,
@@ -72,27 +133,119 @@ static size_t machineid_raw(unsigned char *const outputBuffer,
     const size_t outputBufferSize);
 
 static char machineid_random_bytes(unsigned char *const outputBuffer,
-    const size_t count);
+    const size_t count, unsigned long *const rngState);
 
 static char machineid_sha256(unsigned char *const outputBuffer,
     const unsigned char *const inputBuffer, const size_t inputBufferSize);
 
+static enum machineid_error machineid_compute(unsigned char *const hashBuffer,
+    unsigned char *const rawBuffer, size_t *const rawSize,
+    unsigned long *const rngState, const char preferBackend);
+
+static void machineid_format(unsigned char *const outputBuffer,
+    const unsigned char *const hashBuffer, const enum machineid_flags flags);
+
+static char machineid_prefetch_take(unsigned char *const hashBuffer,
+    enum machineid_error *const err);
+
+#ifndef MACHINEID_MINIMAL
+static char machineid_component_store(
+    struct machineid_fingerprint *const fingerprint,
+    const enum machineid_component component,
+    const unsigned char *const rawBuffer, size_t rawSize);
+#endif
+
 const char *const HEX_ALPHABET = "0123456789abcdef";
 
 #ifndef MIN
 #define MIN(X, Y) (((X) < (Y)) ? (X) : (Y))
 #endif
 
-static char
-machineid_random_bytes(unsigned char *const outputBuffer, const size_t count)
+/*
+ * A xorshift32 step used in place of rand when a context supplies its own
+ * state. Like rand it is not suitable for anything beyond fallback
+ * identifiers, but it does not touch any state shared between threads.
+ */
+static unsigned long
+machineid_xorshift32(unsigned long *const state)
+{
+    unsigned long x;
+
+    x = *state & 0xFFFFFFFFUL;
+    x ^= (x << 13) & 0xFFFFFFFFUL;
+    x ^= x >> 17;
+    x ^= (x << 5) & 0xFFFFFFFFUL;
+    *state = x;
+
+    return x;
+}
+
+/* guards the prefetched result and its statistics */
+#ifdef MACHINEID_PTHREADS
+static pthread_mutex_t prefetchLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t prefetchCond = PTHREAD_COND_INITIALIZER;
+
+#define machineid_lock() pthread_mutex_lock(&prefetchLock)
+#define machineid_unlock() pthread_mutex_unlock(&prefetchLock)
+#define machineid_wait() pthread_cond_wait(&prefetchCond, &prefetchLock)
+#define machineid_broadcast() pthread_cond_broadcast(&prefetchCond)
+
+#ifdef __GNUC__
+#define machineid_fence() __sync_synchronize()
+#endif
+#elif defined(MACHINEID_WIN32_THREADS)
+static SRWLOCK prefetchLock = SRWLOCK_INIT;
+static CONDITION_VARIABLE prefetchCond = CONDITION_VARIABLE_INIT;
+
+#define machineid_lock() AcquireSRWLockExclusive(&prefetchLock)
+#define machineid_unlock() ReleaseSRWLockExclusive(&prefetchLock)
+#define machineid_wait() SleepConditionVariableSRW(&prefetchCond, \
+    &prefetchLock, INFINITE, 0)
+#define machineid_broadcast() WakeAllConditionVariable(&prefetchCond)
+#define machineid_fence() MemoryBarrier()
+#else
+#define machineid_lock()
+#define machineid_unlock()
+#define machineid_wait()
+#define machineid_broadcast()
+#endif
+
+static double
+machineid_now(void)
 {
-#ifdef MACHINEID_USE_SODIUM
-    randombytes_buf((void *const)outputBuffer, count);
+#ifdef MACHINEID_PTHREADS
+    struct timespec ts;
+
+    if (clock_gettime(CLOCK_MONOTONIC, &ts) != 0) {
+        return 0;
+    }
 
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+#elif defined(MACHINEID_WIN32_THREADS)
+    LARGE_INTEGER counter, frequency;
+
+    QueryPerformanceCounter(&counter);
+    QueryPerformanceFrequency(&frequency);
+
+    return (double)counter.QuadPart / (double)frequency.QuadPart;
+#else
     return 0;
-#elif MACHINEID_USE_OPENSSL
-    return RAND_bytes(outputBuffer, (int)count) != 0;
-#elif defined(__OpenBSD__) || defined(__FreeBSD__)
+#endif
+}
+
+static unsigned long
+machineid_microseconds(const double seconds)
+{
+    return seconds > 0 ? (unsigned long)(seconds * 1e6) : 0;
+}
+
+static char
+machineid_vendored_random(unsigned char *const outputBuffer,
+    const size_t count, unsigned long *const rngState)
+{
+#if defined(__OpenBSD__) || defined(__FreeBSD__)
+    (void)rngState;
+
     arc4random_buf((void *const)outputBuffer, count);
 
     return 0;
@@ -100,268 +253,1726 @@ machineid_random_bytes(unsigned char *const outputBuffer, const size_t count)
     size_t i;
     errno_t err;
 
+    (void)rngState;
+
     for (i = 0; i < count; i++) {
         unsigned int number;
 
-        err = rand_s(&number);
+        err = rand_s(&number);
+
+        if (err != 0) {
+            return 1;
+        }
+
+        outputBuffer[i] = number;
+    }
+
+    return 0;
+#else
+    size_t i;
+
+    if (rngState != NULL) {
+        for (i = 0; i < count; i++) {
+            outputBuffer[i] = (unsigned char)machineid_xorshift32(rngState);
+        }
+    } else {
+        for (i = 0; i < count; i++) {
+            outputBuffer[i] = rand();
+        }
+    }
+
+    return 0;
+#endif
+}
+
+static char
+machineid_vendored_sha256(unsigned char *const outputBuffer,
+    const unsigned char *const inputBuffer, const size_t inputBufferSize)
+{
+    SHA256_CTX context;
+
+    sha256_init(&context);
+    sha256_update(&context, (const LIBSHA256_BYTE *const)inputBuffer,
+        inputBufferSize);
+    sha256_final(&context, (LIBSHA256_BYTE *const)outputBuffer);
+
+    return 0;
+}
+
+#ifndef MACHINEID_MINIMAL
+static char
+machineid_vendored_load(void)
+{
+    return 0;
+}
+
+#ifdef MACHINEID_DLOPEN
+/*
+ * Shared libraries are opened once and never closed, symbols are copied into
+ * function pointers with memcpy as ISO C has no conversion between object
+ * and function pointers.
+ */
+static void *
+machineid_dl_open(const char *const *names)
+{
+    void *library;
+
+    for (; *names != NULL; names++) {
+#ifdef _WIN32
+        library = (void *)LoadLibraryA(*names);
+#else
+        library = dlopen(*names, RTLD_NOW | RTLD_LOCAL);
+#endif
+
+        if (library != NULL) {
+            return library;
+        }
+    }
+
+    return NULL;
+}
+
+static char
+machineid_dl_symbol(void *const library, const char *const name,
+    void *const function, const size_t functionSize)
+{
+#ifdef _WIN32
+    FARPROC symbol;
+
+    symbol = GetProcAddress((HMODULE)library, name);
+#else
+    void *symbol;
+
+    symbol = dlsym(library, name);
+#endif
+
+    if (symbol == NULL) {
+        return 1;
+    }
+
+    memcpy(function, &symbol, functionSize);
+
+    return 0;
+}
+
+static const char *const OPENSSL_LIBRARIES[] = {
+#ifdef _WIN32
+    "libcrypto-3-x64.dll", "libcrypto-3.dll", "libcrypto-1_1-x64.dll",
+    "libcrypto-1_1.dll",
+#elif defined(__APPLE__)
+    "libcrypto.3.dylib", "libcrypto.1.1.dylib", "libcrypto.dylib",
+#else
+    "libcrypto.so.3", "libcrypto.so.1.1", "libcrypto.so",
+#endif
+    NULL
+};
+
+static const char *const SODIUM_LIBRARIES[] = {
+#ifdef _WIN32
+    "libsodium.dll",
+#elif defined(__APPLE__)
+    "libsodium.26.dylib", "libsodium.23.dylib", "libsodium.dylib",
+#else
+    "libsodium.so.26", "libsodium.so.23", "libsodium.so",
+#endif
+    NULL
+};
+
+static unsigned char *(*opensslSHA256)(const unsigned char *, size_t,
+    unsigned char *);
+static int (*opensslRandBytes)(unsigned char *, int);
+
+static int (*sodiumInit)(void);
+static int (*sodiumSHA256)(unsigned char *, const unsigned char *,
+    uint64_t);
+static void (*sodiumRandomBytes)(void *, size_t);
+
+static char
+machineid_openssl_load(void)
+{
+    void *library;
+
+    library = machineid_dl_open(OPENSSL_LIBRARIES);
+
+    if (library == NULL) {
+        return 1;
+    }
+
+    return machineid_dl_symbol(library, "SHA256", &opensslSHA256,
+            sizeof(opensslSHA256))
+        || machineid_dl_symbol(library, "RAND_bytes", &opensslRandBytes,
+            sizeof(opensslRandBytes));
+}
+
+static char
+machineid_openssl_sha256(unsigned char *const outputBuffer,
+    const unsigned char *const inputBuffer, const size_t inputBufferSize)
+{
+    return opensslSHA256(inputBuffer, inputBufferSize, outputBuffer) == NULL;
+}
+
+static char
+machineid_openssl_random(unsigned char *const outputBuffer,
+    const size_t count, unsigned long *const rngState)
+{
+    (void)rngState;
+
+    return opensslRandBytes(outputBuffer, (int)count) != 1;
+}
+
+static char
+machineid_sodium_load(void)
+{
+    void *library;
+
+    library = machineid_dl_open(SODIUM_LIBRARIES);
+
+    if (library == NULL) {
+        return 1;
+    }
+
+    if (machineid_dl_symbol(library, "sodium_init", &sodiumInit,
+            sizeof(sodiumInit))
+        || machineid_dl_symbol(library, "crypto_hash_sha256", &sodiumSHA256,
+            sizeof(sodiumSHA256))
+        || machineid_dl_symbol(library, "randombytes_buf",
+            &sodiumRandomBytes, sizeof(sodiumRandomBytes))) {
+        return 1;
+    }
+
+    return sodiumInit() == -1;
+}
+
+static char
+machineid_sodium_sha256(unsigned char *const outputBuffer,
+    const unsigned char *const inputBuffer, const size_t inputBufferSize)
+{
+    return sodiumSHA256(outputBuffer, inputBuffer, inputBufferSize) != 0;
+}
+
+static char
+machineid_sodium_random(unsigned char *const outputBuffer,
+    const size_t count, unsigned long *const rngState)
+{
+    (void)rngState;
+
+    sodiumRandomBytes(outputBuffer, count);
+
+    return 0;
+}
+#endif
+
+/*
+ * Each backend is probed at most once, outside of the lock. Loading a library
+ * can block on the dynamic loader while constructors run, so it must never
+ * happen while holding a lock other threads wait on.
+ */
+#ifdef MACHINEID_PTHREADS
+typedef pthread_once_t machineid_once_t;
+
+#define MACHINEID_ONCE_INIT PTHREAD_ONCE_INIT
+#define machineid_once(once, routine) pthread_once(once, routine)
+#elif defined(MACHINEID_WIN32_THREADS)
+typedef INIT_ONCE machineid_once_t;
+
+#define MACHINEID_ONCE_INIT INIT_ONCE_STATIC_INIT
+
+static BOOL CALLBACK
+machineid_once_routine(PINIT_ONCE once, PVOID parameter, PVOID *context)
+{
+    void (*routine)(void);
+
+    (void)once;
+    (void)context;
+
+    memcpy(&routine, &parameter, sizeof(routine));
+
+    routine();
+
+    return TRUE;
+}
+
+static void
+machineid_once(machineid_once_t *const once, void (*routine)(void))
+{
+    PVOID parameter;
+
+    memcpy(&parameter, &routine, sizeof(parameter));
+
+    InitOnceExecuteOnce(once, machineid_once_routine, parameter, NULL);
+}
+#else
+typedef char machineid_once_t;
+
+#define MACHINEID_ONCE_INIT 0
+
+static void
+machineid_once(machineid_once_t *const once, void (*routine)(void))
+{
+    if (*once == 0) {
+        *once = 1;
+
+        routine();
+    }
+}
+#endif
+
+enum machineid_backend_state {
+    MACHINEID_BACKEND_UNPROBED = 0,
+    MACHINEID_BACKEND_TRUSTED  = 1,
+    MACHINEID_BACKEND_REJECTED = 2
+};
+
+static void machineid_vendored_probe(void);
+
+#ifdef MACHINEID_DLOPEN
+static void machineid_openssl_probe(void);
+
+static void machineid_sodium_probe(void);
+#endif
+
+/* indexed by enum machineid_backend, MACHINEID_BACKEND_AUTO is never used */
+static struct {
+    char (*load)(void);
+    char (*sha256)(unsigned char *const outputBuffer,
+        const unsigned char *const inputBuffer, const size_t inputBufferSize);
+    char (*random)(unsigned char *const outputBuffer, const size_t count,
+        unsigned long *const rngState);
+    void (*probe)(void);
+    enum machineid_backend_state state;
+    machineid_once_t once;
+} backends[MACHINEID_BACKEND_COUNT] = {
+    { NULL, NULL, NULL, NULL, MACHINEID_BACKEND_REJECTED,
+        MACHINEID_ONCE_INIT },
+    { machineid_vendored_load, machineid_vendored_sha256,
+        machineid_vendored_random, machineid_vendored_probe,
+        MACHINEID_BACKEND_UNPROBED, MACHINEID_ONCE_INIT },
+#ifdef MACHINEID_DLOPEN
+    { machineid_openssl_load, machineid_openssl_sha256,
+        machineid_openssl_random, machineid_openssl_probe,
+        MACHINEID_BACKEND_UNPROBED, MACHINEID_ONCE_INIT },
+    { machineid_sodium_load, machineid_sodium_sha256,
+        machineid_sodium_random, machineid_sodium_probe,
+        MACHINEID_BACKEND_UNPROBED, MACHINEID_ONCE_INIT }
+#else
+    { NULL, NULL, NULL, NULL, MACHINEID_BACKEND_REJECTED,
+        MACHINEID_ONCE_INIT },
+    { NULL, NULL, NULL, NULL, MACHINEID_BACKEND_REJECTED,
+        MACHINEID_ONCE_INIT }
+#endif
+};
+
+/*
+ * Read without the lock. Only backends whose probe has completed are ever
+ * published here, and the vendored backend needs no probe to be used.
+ */
+static volatile enum machineid_backend activeBackend =
+    MACHINEID_BACKEND_VENDORED;
+
+/*
+ * Known answers from FIPS 180-2, the second spans two blocks and has a
+ * length that is at least 32 modulo 64.
+ */
+static const unsigned char KAT_SHA256_SHORT[MACHINEID_HASH_SIZE] = {
+    0xba, 0x78, 0x16, 0xbf, 0x8f, 0x01, 0xcf, 0xea,
+    0x41, 0x41, 0x40, 0xde, 0x5d, 0xae, 0x22, 0x23,
+    0xb0, 0x03, 0x61, 0xa3, 0x96, 0x17, 0x7a, 0x9c,
+    0xb4, 0x10, 0xff, 0x61, 0xf2, 0x00, 0x15, 0xad
+};
+
+static const unsigned char KAT_SHA256_LONG[MACHINEID_HASH_SIZE] = {
+    0x24, 0x8d, 0x6a, 0x61, 0xd2, 0x06, 0x38, 0xb8,
+    0xe5, 0xc0, 0x26, 0x93, 0x0c, 0x3e, 0x60, 0x39,
+    0xa3, 0x3c, 0xe4, 0x59, 0x64, 0xff, 0x21, 0x67,
+    0xf6, 0xec, 0xed, 0xd4, 0x19, 0xdb, 0x06, 0xc1
+};
+
+static char
+machineid_backend_known_answers(const enum machineid_backend backend)
+{
+    static const char *const shortMessage = "abc";
+    static const char *const longMessage =
+        "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq";
+    unsigned char hashBuffer[MACHINEID_HASH_SIZE], first[16], second[16];
+    unsigned long rngState;
+
+    if (backends[backend].sha256(hashBuffer,
+            (const unsigned char *)shortMessage, strlen(shortMessage)) != 0
+        || memcmp(hashBuffer, KAT_SHA256_SHORT, sizeof(hashBuffer)) != 0) {
+        return 1;
+    }
+
+    if (backends[backend].sha256(hashBuffer,
+            (const unsigned char *)longMessage, strlen(longMessage)) != 0
+        || memcmp(hashBuffer, KAT_SHA256_LONG, sizeof(hashBuffer)) != 0) {
+        return 1;
+    }
+
+    /* a generator can not be checked against answers, only for liveness */
+    rngState = 0x9E3779B9UL;
+
+    if (backends[backend].random(first, sizeof(first), &rngState) != 0
+        || backends[backend].random(second, sizeof(second), &rngState) != 0) {
+        return 1;
+    }
+
+    return memcmp(first, second, sizeof(first)) == 0;
+}
+
+static void
+machineid_backend_probe(const enum machineid_backend backend)
+{
+    if (backends[backend].load() == 0
+        && machineid_backend_known_answers(backend) == 0) {
+        backends[backend].state = MACHINEID_BACKEND_TRUSTED;
+    } else {
+        backends[backend].state = MACHINEID_BACKEND_REJECTED;
+    }
+}
+
+static void
+machineid_vendored_probe(void)
+{
+    machineid_backend_probe(MACHINEID_BACKEND_VENDORED);
+}
+
+#ifdef MACHINEID_DLOPEN
+static void
+machineid_openssl_probe(void)
+{
+    machineid_backend_probe(MACHINEID_BACKEND_OPENSSL);
+}
+
+static void
+machineid_sodium_probe(void)
+{
+    machineid_backend_probe(MACHINEID_BACKEND_SODIUM);
+}
+#endif
+
+/* loads and checks the backend the first time it is asked about */
+static char
+machineid_backend_trusted(const enum machineid_backend backend)
+{
+    if ((unsigned int)backend >= MACHINEID_BACKEND_COUNT
+        || backends[backend].probe == NULL) {
+        return 0;
+    }
+
+    machineid_once(&backends[backend].once, backends[backend].probe);
+
+    return backends[backend].state == MACHINEID_BACKEND_TRUSTED;
+}
+
+#if defined(MACHINEID_USE_OPENSSL) || defined(MACHINEID_USE_SODIUM)
+static machineid_once_t preferOnce = MACHINEID_ONCE_INIT;
+
+static void
+machineid_backend_prefer_routine(void)
+{
+#ifdef MACHINEID_USE_OPENSSL
+    if (machineid_backend_trusted(MACHINEID_BACKEND_OPENSSL)) {
+        activeBackend = MACHINEID_BACKEND_OPENSSL;
+    }
+#else
+    if (machineid_backend_trusted(MACHINEID_BACKEND_SODIUM)) {
+        activeBackend = MACHINEID_BACKEND_SODIUM;
+    }
+#endif
+}
+#endif
+
+/*
+ * Applies MACHINEID_USE_OPENSSL or MACHINEID_USE_SODIUM. Never called while
+ * another thread may be waiting on the caller, a library load can block on
+ * the dynamic loader for as long as constructors run.
+ */
+static void
+machineid_backend_prefer(void)
+{
+#if defined(MACHINEID_USE_OPENSSL) || defined(MACHINEID_USE_SODIUM)
+    machineid_once(&preferOnce, machineid_backend_prefer_routine);
+#endif
+}
+
+static enum machineid_backend
+machineid_backend_current(void)
+{
+    enum machineid_backend backend;
+
+    backend = activeBackend;
+
+    /* completed already, this only orders the loaded library before its use */
+    if (backend != MACHINEID_BACKEND_VENDORED) {
+        machineid_backend_trusted(backend);
+    }
+
+    return backend;
+}
+
+#define MACHINEID_BACKEND_ROUNDS 64
+
+/*
+ * The fastest trusted backend at hashing inputs the size of an identifier,
+ * preferring earlier backends on ties. Only run when a caller selects
+ * MACHINEID_BACKEND_AUTO, as it loads every backend.
+ */
+static enum machineid_backend
+machineid_backend_fastest(void)
+{
+    unsigned char rawBuffer[MACHINEID_RAW_SIZE],
+        hashBuffer[MACHINEID_HASH_SIZE];
+    enum machineid_backend fastestBackend;
+    double started, elapsed, fastest;
+    unsigned int backend, i;
+
+    memset(rawBuffer, 0x5A, sizeof(rawBuffer));
+
+    fastestBackend = MACHINEID_BACKEND_VENDORED;
+    fastest = 0;
+
+    for (backend = MACHINEID_BACKEND_VENDORED;
+        backend < MACHINEID_BACKEND_COUNT; backend++) {
+        if (!machineid_backend_trusted((enum machineid_backend)backend)) {
+            continue;
+        }
+
+        started = machineid_now();
+
+        for (i = 0; i < MACHINEID_BACKEND_ROUNDS; i++) {
+            backends[backend].sha256(hashBuffer, rawBuffer,
+                sizeof(rawBuffer));
+        }
+
+        elapsed = machineid_now() - started;
+
+        if (backend == MACHINEID_BACKEND_VENDORED || elapsed < fastest) {
+            fastestBackend = (enum machineid_backend)backend;
+            fastest = elapsed;
+        }
+    }
+
+    return fastestBackend;
+}
+
+static char
+machineid_random_bytes(unsigned char *const outputBuffer, const size_t count,
+    unsigned long *const rngState)
+{
+    return backends[machineid_backend_current()].random(outputBuffer, count,
+        rngState);
+}
+
+static char
+machineid_sha256(unsigned char *const outputBuffer,
+    const unsigned char *const inputBuffer, const size_t inputBufferSize)
+{
+    return backends[machineid_backend_current()].sha256(outputBuffer,
+        inputBuffer, inputBufferSize);
+}
+
+enum machineid_error
+machineid_backend_select(const enum machineid_backend backend)
+{
+    /* applied first so it can not later replace this selection */
+    machineid_backend_prefer();
+
+    if (backend == MACHINEID_BACKEND_AUTO) {
+        activeBackend = machineid_backend_fastest();
+    } else if (machineid_backend_trusted(backend)) {
+        activeBackend = backend;
+    } else {
+        return MACHINEID_ERROR_BACKEND_UNAVAILABLE;
+    }
+
+    return MACHINEID_ERROR_NONE;
+}
+
+enum machineid_backend
+machineid_backend_get(void)
+{
+    machineid_backend_prefer();
+
+    return activeBackend;
+}
+
+int
+machineid_backend_available(const enum machineid_backend backend)
+{
+    return machineid_backend_trusted(backend);
+}
+
+const char *
+machineid_backend_to_string(const enum machineid_backend backend)
+{
+    switch (backend) {
+        case MACHINEID_BACKEND_AUTO:
+            return "MACHINEID_BACKEND_AUTO";
+            break;
+
+        case MACHINEID_BACKEND_VENDORED:
+            return "MACHINEID_BACKEND_VENDORED";
+            break;
+
+        case MACHINEID_BACKEND_OPENSSL:
+            return "MACHINEID_BACKEND_OPENSSL";
+            break;
+
+        case MACHINEID_BACKEND_SODIUM:
+            return "MACHINEID_BACKEND_SODIUM";
+            break;
+
+        case MACHINEID_BACKEND_COUNT:
+            break;
+    }
+
+    return NULL;
+}
+#else
+#define machineid_backend_prefer()
+
+static char
+machineid_random_bytes(unsigned char *const outputBuffer, const size_t count,
+    unsigned long *const rngState)
+{
+    return machineid_vendored_random(outputBuffer, count, rngState);
+}
+
+static char
+machineid_sha256(unsigned char *const outputBuffer,
+    const unsigned char *const inputBuffer, const size_t inputBufferSize)
+{
+    return machineid_vendored_sha256(outputBuffer, inputBuffer,
+        inputBufferSize);
+}
+#endif
+
+static enum machineid_error
+machineid_compute(unsigned char *const hashBuffer,
+    unsigned char *const rawBuffer, size_t *const rawSize,
+    unsigned long *const rngState, const char preferBackend)
+{
+    char fallback;
+    int status;
+
+    fallback = 0;
+
+    *rawSize = machineid_raw(rawBuffer, MACHINEID_RAW_SIZE);
+
+    /*
+     * Every backend hashes identically, so a preferred backend is only
+     * loaded for its random number generator
+     */
+    if (*rawSize == 0) {
+        if (preferBackend) {
+            machineid_backend_prefer();
+        }
+
+        if (machineid_random_bytes(rawBuffer, 16, rngState)) {
+            return MACHINEID_ERROR_RNG;
+        } else {
+            *rawSize = 16;
+            fallback = 1;
+        }
+    }
+
+    status = machineid_sha256(hashBuffer, rawBuffer, *rawSize);
+
+    if (status != 0) {
+        return MACHINEID_ERROR_HASH_FAILURE;
+    }
+
+    if (fallback == 1) {
+        return MACHINEID_ERROR_FALLBACK;
+    } else {
+        return MACHINEID_ERROR_NONE;
+    }
+}
+
+static void
+machineid_format(unsigned char *const outputBuffer,
+    const unsigned char *const hashBuffer, const enum machineid_flags flags)
+{
+    if (flags & MACHINEID_FLAG_AS_UUID) {
+        machineid_bin_to_uuid(outputBuffer, hashBuffer);
+    } else {
+        memcpy(outputBuffer, hashBuffer, MACHINEID_HASH_SIZE);
+    }
+
+    if (flags & MACHINEID_FLAG_NULL_TERMINATE) {
+        if (flags & MACHINEID_FLAG_AS_UUID) {
+            outputBuffer[MACHINEID_UUID_SIZE] = '\0';
+        } else {
+            outputBuffer[MACHINEID_HASH_SIZE] = '\0';
+        }
+    }
+}
+
+enum machineid_error
+machineid_generate(unsigned char *const outputBuffer,
+    const enum machineid_flags flags)
+{
+    unsigned char rawBuffer[MACHINEID_RAW_SIZE],
+        hashBuffer[MACHINEID_HASH_SIZE];
+    size_t rawSize;
+    enum machineid_error err;
+
+    if (outputBuffer == NULL) {
+        return MACHINEID_ERROR_NULL_OUTPUT_BUFFER;
+    }
+
+    if (machineid_prefetch_take(hashBuffer, &err) == 0) {
+        err = machineid_compute(hashBuffer, rawBuffer, &rawSize, NULL, 1);
+    }
+
+    if (err != MACHINEID_ERROR_NONE && err != MACHINEID_ERROR_FALLBACK) {
+        return err;
+    }
+
+    machineid_format(outputBuffer, hashBuffer, flags);
+
+    return err;
+}
+
+/*
+ * Process wide result warmed by machineid_prefetch. Until a prefetch has
+ * been requested machineid_generate only reads prefetchRequested, and never
+ * takes the lock. The flag is read without the lock, a caller that misses a
+ * concurrent request simply computes the identifier itself.
+ *
+ * A READY result never changes again. The first call it serves records the
+ * statistics under the lock and then sets prefetchServed behind a fence, so
+ * every later call copies the result without the lock. Where no fence is
+ * available every call locks, which costs nothing without threads.
+ */
+enum machineid_prefetch_state {
+    MACHINEID_PREFETCH_IDLE    = 0,
+    MACHINEID_PREFETCH_RUNNING = 1,
+    MACHINEID_PREFETCH_READY   = 2
+};
+
+static struct {
+    enum machineid_prefetch_state state;
+    enum machineid_error status;
+    unsigned char hashBuffer[MACHINEID_HASH_SIZE];
+    double started;
+    struct machineid_stats stats;
+} prefetch;
+
+static volatile int prefetchRequested;
+#ifdef machineid_fence
+static volatile int prefetchServed;
+#endif
+
+#ifdef MACHINEID_PTHREADS
+static pthread_once_t prefetchForkOnce = PTHREAD_ONCE_INIT;
+
+/*
+ * The lock is held across fork so the child inherits consistent state. Only
+ * the forking thread exists in the child, so a prefetch that was running can
+ * never finish there and is reset.
+ */
+static void
+machineid_prefetch_fork_prepare(void)
+{
+    machineid_lock();
+}
+
+static void
+machineid_prefetch_fork_parent(void)
+{
+    machineid_unlock();
+}
+
+static void
+machineid_prefetch_fork_child(void)
+{
+    if (prefetch.state == MACHINEID_PREFETCH_RUNNING) {
+        prefetch.state = MACHINEID_PREFETCH_IDLE;
+    }
+
+    machineid_unlock();
+}
+
+static void
+machineid_prefetch_fork_register(void)
+{
+    pthread_atfork(machineid_prefetch_fork_prepare,
+        machineid_prefetch_fork_parent, machineid_prefetch_fork_child);
+}
+#endif
+
+static void
+machineid_prefetch_run(void)
+{
+    unsigned char rawBuffer[MACHINEID_RAW_SIZE],
+        hashBuffer[MACHINEID_HASH_SIZE];
+    size_t rawSize;
+    enum machineid_error err;
+
+    /* callers may be waiting on this thread, so it must not load anything */
+    err = machineid_compute(hashBuffer, rawBuffer, &rawSize, NULL, 0);
+
+    machineid_lock();
+
+    prefetch.stats.prefetchMicroseconds =
+        machineid_microseconds(machineid_now() - prefetch.started);
+
+    /* on failure callers fall back to computing the identifier themselves */
+    if (err != MACHINEID_ERROR_NONE && err != MACHINEID_ERROR_FALLBACK) {
+        prefetch.state = MACHINEID_PREFETCH_IDLE;
+    } else {
+        memcpy(prefetch.hashBuffer, hashBuffer, sizeof(hashBuffer));
+        prefetch.status = err;
+        prefetch.state = MACHINEID_PREFETCH_READY;
+    }
+
+    machineid_broadcast();
+    machineid_unlock();
+
+    /* nobody waits on this thread any longer, load off the hot path */
+    machineid_backend_prefer();
+}
+
+#ifdef MACHINEID_PTHREADS
+static void *
+machineid_prefetch_thread(void *arg)
+{
+    (void)arg;
+
+    machineid_prefetch_run();
+
+    return NULL;
+}
+#elif defined(MACHINEID_WIN32_THREADS)
+static DWORD WINAPI
+machineid_prefetch_thread(LPVOID arg)
+{
+    (void)arg;
+
+    machineid_prefetch_run();
+
+    return 0;
+}
+#endif
+
+enum machineid_error
+machineid_prefetch(void)
+{
+#ifdef MACHINEID_PTHREADS
+    pthread_t thread;
+#elif defined(MACHINEID_WIN32_THREADS)
+    HANDLE thread;
+#endif
+
+#ifdef MACHINEID_PTHREADS
+    pthread_once(&prefetchForkOnce, machineid_prefetch_fork_register);
+#endif
+
+    machineid_lock();
+
+    prefetchRequested = 1;
+
+    if (prefetch.state != MACHINEID_PREFETCH_IDLE) {
+        machineid_unlock();
+
+        return MACHINEID_ERROR_NONE;
+    }
+
+    prefetch.state = MACHINEID_PREFETCH_RUNNING;
+    prefetch.started = machineid_now();
+    prefetch.stats.prefetches++;
+
+    machineid_unlock();
+
+#ifdef MACHINEID_PTHREADS
+    if (pthread_create(&thread, NULL, machineid_prefetch_thread, NULL) != 0) {
+        goto err;
+    }
+
+    pthread_detach(thread);
+#elif defined(MACHINEID_WIN32_THREADS)
+    thread = CreateThread(NULL, 0, machineid_prefetch_thread, NULL, 0, NULL);
+
+    if (thread == NULL) {
+        goto err;
+    }
+
+    CloseHandle(thread);
+#else
+    machineid_prefetch_run();
+#endif
+
+    return MACHINEID_ERROR_NONE;
+
+#if defined(MACHINEID_PTHREADS) || defined(MACHINEID_WIN32_THREADS)
+  err:
+    machineid_lock();
+
+    prefetch.state = MACHINEID_PREFETCH_IDLE;
+
+    machineid_broadcast();
+    machineid_unlock();
+
+    return MACHINEID_ERROR_THREAD;
+#endif
+}
+
+#if defined(MACHINEID_PREFETCH_ON_LOAD) && defined(__GNUC__)
+static void machineid_prefetch_on_load(void) __attribute__((constructor));
+
+static void
+machineid_prefetch_on_load(void)
+{
+    machineid_prefetch();
+}
+#endif
+
+static char
+machineid_prefetch_take(unsigned char *const hashBuffer,
+    enum machineid_error *const err)
+{
+    double waitStarted;
+    unsigned long waited;
+    char taken, waiting;
+
+    if (!prefetchRequested) {
+        return 0;
+    }
+
+#ifdef machineid_fence
+    if (prefetchServed) {
+        machineid_fence();
+        memcpy(hashBuffer, prefetch.hashBuffer, MACHINEID_HASH_SIZE);
+        *err = prefetch.status;
+
+        return 1;
+    }
+#endif
+
+    taken = 0;
+    waited = 0;
+    waiting = 0;
+
+    machineid_lock();
+
+    if (prefetch.state == MACHINEID_PREFETCH_RUNNING) {
+        waiting = 1;
+        waitStarted = machineid_now();
+
+        while (prefetch.state == MACHINEID_PREFETCH_RUNNING) {
+            machineid_wait();
+        }
+
+        waited = machineid_microseconds(machineid_now() - waitStarted);
+
+        prefetch.stats.prefetchWaits++;
+        prefetch.stats.waitMicroseconds += waited;
+    }
+
+    if (prefetch.state == MACHINEID_PREFETCH_READY) {
+        memcpy(hashBuffer, prefetch.hashBuffer, MACHINEID_HASH_SIZE);
+        *err = prefetch.status;
+        taken = 1;
+
+        if (prefetch.stats.prefetchHits == 0
+            && prefetch.stats.prefetchMicroseconds > waited) {
+            prefetch.stats.savedMicroseconds =
+                prefetch.stats.prefetchMicroseconds - waited;
+        }
+
+        if (prefetch.stats.prefetchHits == 0 || waiting) {
+            prefetch.stats.prefetchHits++;
+        }
+
+#ifdef machineid_fence
+        machineid_fence();
+        prefetchServed = 1;
+#endif
+    }
+
+    machineid_unlock();
+
+    return taken;
+}
+
+void
+machineid_stats_get(struct machineid_stats *const stats)
+{
+    if (stats == NULL) {
+        return;
+    }
+
+    if (!prefetchRequested) {
+        memset(stats, 0, sizeof(*stats));
+
+        return;
+    }
+
+    machineid_lock();
+
+    *stats = prefetch.stats;
+
+    machineid_unlock();
+}
+
+void
+machineid_ctx_init(struct machineid_ctx *const ctx, const unsigned long seed)
+{
+    memset(ctx, 0, sizeof(*ctx));
+
+    /* xorshift32 never leaves the all zero state */
+    ctx->rngState = (seed & 0xFFFFFFFFUL) != 0 ? seed : 0x9E3779B9UL;
+    ctx->status = MACHINEID_ERROR_NONE;
+    ctx->cached = 0;
+}
+
+enum machineid_error
+machineid_ctx_generate(struct machineid_ctx *const ctx,
+    unsigned char *const outputBuffer, const enum machineid_flags flags)
+{
+    enum machineid_error err;
+
+    if (ctx == NULL) {
+        return MACHINEID_ERROR_NULL_CONTEXT;
+    }
+
+    if (outputBuffer == NULL) {
+        return MACHINEID_ERROR_NULL_OUTPUT_BUFFER;
+    }
+
+    if (ctx->cached == 0) {
+        err = machineid_compute(ctx->hashBuffer, ctx->rawBuffer,
+            &ctx->rawSize, &ctx->rngState, 1);
+
+        if (err != MACHINEID_ERROR_NONE && err != MACHINEID_ERROR_FALLBACK) {
+            return err;
+        }
+
+        ctx->status = err;
+        ctx->cached = 1;
+    }
+
+    machineid_format(outputBuffer, ctx->hashBuffer, flags);
+
+    return ctx->status;
+}
+
+#if defined(__linux__) || defined(__FreeBSD__) || defined(__OpenBSD__)
+#ifdef MACHINEID_MINIMAL
+/* reads directly into the result, without stdio or its buffers */
+static size_t
+posix_read_file(const char *const path, unsigned char *const outputBuffer,
+    const size_t outputBufferSize)
+{
+    int handle;
+    ssize_t status;
+    size_t resultSize;
+
+    do {
+        handle = open(path, O_RDONLY | MACHINEID_O_CLOEXEC);
+    } while (handle == -1 && errno == EINTR);
+
+    if (handle == -1) {
+        return 0;
+    }
+
+    resultSize = 0;
+
+    while (resultSize < outputBufferSize) {
+        status = read(handle, outputBuffer + resultSize,
+            outputBufferSize - resultSize);
+
+        if (status == 0) {
+            break;
+        }
+
+        if (status == -1 && errno == EINTR) {
+            continue;
+        }
+
+        if (status == -1) {
+            resultSize = 0;
+
+            break;
+        }
+
+        resultSize += (size_t)status;
+    }
+
+    close(handle);
+
+    return resultSize;
+}
+#else
+static size_t
+posix_read_file(const char *const path, unsigned char *const outputBuffer,
+    const size_t outputBufferSize)
+{
+    FILE *handle;
+    size_t resultSize;
+
+    handle = fopen(path, "r");
+
+    if (handle == NULL) {
+        return 0;
+    }
+
+    /*
+     * Read up to the end of the file rather than trusting the size reported
+     * by the file system, sysfs attributes always report a size of 4096.
+     */
+    resultSize = fread(outputBuffer, sizeof(unsigned char), outputBufferSize,
+        handle);
+
+    if (ferror(handle)) {
+        resultSize = 0;
+    }
+
+    fclose(handle);
+
+    return resultSize;
+}
+#endif
+#endif
+
+size_t
+machineid_raw(unsigned char *const outputBuffer, const size_t outputBufferSize)
+{
+#ifdef __linux__
+    size_t resultSize;
+
+    resultSize = posix_read_file("/etc/machine-id", outputBuffer,
+        outputBufferSize);
+
+    if (resultSize != 0) {
+        return resultSize;
+    }
+
+    return posix_read_file("/var/lib/dbus/machine-id", outputBuffer,
+        outputBufferSize);
+#elif __FreeBSD__
+    return posix_read_file("/etc/hostid", outputBuffer,
+        outputBufferSize);
+#elif __OpenBSD__
+    int mib[2], status;
+    size_t len;
+
+    mib[0] = CTL_HW;
+    mib[1] = HW_UUID;
+
+    status = sysctl(mib, 2, NULL, &len, NULL, 0);
+
+    if (status == -1) {
+        goto fallback;
+    }
+
+    if (len >= outputBufferSize) {
+        goto fallback;
+    }
+
+    status = sysctl(mib, 2, outputBuffer, &len, NULL, 0);
+
+    if (status != -1) {
+        goto fallback;
+    }
+
+    return len;
+
+  fallback:
+    return posix_read_file("/etc/machine-id", outputBuffer,
+        outputBufferSize);
+#elif __APPLE__
+    io_registry_entry_t registryEntry;
+    CFStringRef identifier;
+    Boolean status;
+
+    registryEntry = IORegistryEntryFromPath(kIOMasterPortDefault,
+        "IOService:/");
+
+    if (registryEntry == MACH_PORT_NULL) {
+        return 0;
+    }
+
+    identifier = (CFStringRef)IORegistryEntryCreateCFProperty(registryEntry,
+        CFSTR(kIOPlatformUUIDKey), kCFAllocatorDefault, 0);
+
+    IOObjectRelease(registryEntry);
+
+    if (identifier == NULL) {
+        return 0;
+    }
+
+    status = CFStringGetCString(identifier, (char *const)outputBuffer,
+        (CFIndex)outputBufferSize, kCFStringEncodingASCII);
+
+    if (status == false) {
+         CFRelease(identifier);
+
+         return 0;
+    }
+
+    CFRelease(identifier);
+
+    return strlen((const char *const)outputBuffer) + 1;
+#elif _WIN32
+    LSTATUS status;
+    HKEY key;
+    DWORD lpType, lpcbData;
+
+    status = RegOpenKeyExA(HKEY_LOCAL_MACHINE,
+        "SOFTWARE\\Microsoft\\Cryptography", 0,
+        KEY_READ | KEY_WOW64_64KEY, &key);
+
+    if (status != ERROR_SUCCESS) {
+        return 0;
+    }
+
+    lpType = REG_SZ;
+    lpcbData = (DWORD)outputBufferSize;
+
+    status = RegQueryValueExA(key, "MachineGuid", NULL, &lpType, outputBuffer,
+        &lpcbData);
+
+    if (status != ERROR_SUCCESS) {
+        RegCloseKey(key);
+
+        return 0;
+    }
+
+    return (size_t)lpcbData;
+#else
+    return 0;
+#endif
+}
+
+/*
+ * Fingerprints are left out of the minimal profile, they need stdio and
+ * directory traversal.
+ */
+#ifndef MACHINEID_MINIMAL
+#ifdef __linux__
+#define LINUX_MAC_SIZE 18
+
+/*
+ * Collects the addresses of every Ethernet interface backed by a physical
+ * device, leaving out SR-IOV virtual functions whose addresses are often
+ * assigned at random on boot. When there are more than fit, the smallest
+ * addresses are kept, so neither enumeration order nor truncation changes
+ * the result.
+ */
+static size_t
+linux_net_macs(unsigned char *const outputBuffer,
+    const size_t outputBufferSize)
+{
+    DIR *dir;
+    struct dirent *entry;
+    struct stat info;
+    char path[80];
+    unsigned char address[64], type[8], *slot;
+    size_t count, capacity, i;
+
+    dir = opendir("/sys/class/net");
+
+    if (dir == NULL) {
+        return 0;
+    }
+
+    count = 0;
+    capacity = outputBufferSize / LINUX_MAC_SIZE;
+
+    while ((entry = readdir(dir)) != NULL && capacity > 0) {
+        if (entry->d_name[0] == '.' || strlen(entry->d_name) > 32) {
+            continue;
+        }
+
+        sprintf(path, "/sys/class/net/%.32s/device", entry->d_name);
+
+        if (stat(path, &info) != 0) {
+            continue;
+        }
+
+        sprintf(path, "/sys/class/net/%.32s/device/physfn", entry->d_name);
+
+        if (stat(path, &info) == 0) {
+            continue;
+        }
+
+        /* ARPHRD_ETHER, other link types have other address lengths */
+        sprintf(path, "/sys/class/net/%.32s/type", entry->d_name);
+
+        if (posix_read_file(path, type, sizeof(type)) != 2
+            || memcmp(type, "1\n", 2) != 0) {
+            continue;
+        }
+
+        sprintf(path, "/sys/class/net/%.32s/address", entry->d_name);
+
+        if (posix_read_file(path, address, sizeof(address)) != LINUX_MAC_SIZE
+            || address[LINUX_MAC_SIZE - 1] != '\n') {
+            continue;
+        }
+
+        if (memcmp(address, "00:00:00:00:00:00", LINUX_MAC_SIZE - 1) == 0) {
+            continue;
+        }
+
+        /* keeps the smallest capacity addresses, in order */
+        if (count < capacity) {
+            count++;
+        } else if (memcmp(address, outputBuffer + (count - 1)
+            * LINUX_MAC_SIZE, LINUX_MAC_SIZE) >= 0) {
+            continue;
+        }
+
+        for (i = count - 1; i > 0; i--) {
+            slot = outputBuffer + (i - 1) * LINUX_MAC_SIZE;
+
+            if (memcmp(slot, address, LINUX_MAC_SIZE) <= 0) {
+                break;
+            }
+
+            memcpy(slot + LINUX_MAC_SIZE, slot, LINUX_MAC_SIZE);
+        }
+
+        memcpy(outputBuffer + i * LINUX_MAC_SIZE, address, LINUX_MAC_SIZE);
+    }
+
+    closedir(dir);
+
+    return count * LINUX_MAC_SIZE;
+}
+
+/*
+ * Finds the block device holding the root file system, and reads the serial
+ * of the disk it lives on. Partitions are resolved to their parent disk.
+ */
+static size_t
+linux_disk_serial(unsigned char *const outputBuffer,
+    const size_t outputBufferSize)
+{
+    static const char *const attributes[] = {
+        "device/serial", "serial", "device/wwid", "wwid"
+    };
+
+    struct stat info;
+    char base[64], path[96];
+    size_t i, resultSize;
+
+    if (stat("/", &info) != 0) {
+        return 0;
+    }
 
-        if (err != 0) {
-            return 1;
-        }
+    sprintf(base, "/sys/dev/block/%u:%u", (unsigned int)major(info.st_dev),
+        (unsigned int)minor(info.st_dev));
 
-        outputBuffer[i] = number;
+    sprintf(path, "%s/partition", base);
+
+    if (stat(path, &info) == 0) {
+        strcat(base, "/..");
     }
 
-    return 0;
-#else
-    size_t i;
+    for (i = 0; i < sizeof(attributes) / sizeof(attributes[0]); i++) {
+        sprintf(path, "%s/%s", base, attributes[i]);
 
-    for (i = 0; i < count; i++) {
-        outputBuffer[i] = rand();
+        resultSize = posix_read_file(path, outputBuffer, outputBufferSize);
+
+        if (resultSize != 0) {
+            return resultSize;
+        }
     }
 
     return 0;
-#endif
 }
+#endif
 
 static char
-machineid_sha256(unsigned char *const outputBuffer,
-    unsigned const char *const inputBuffer,
-    const size_t inputBufferSize)
+machineid_component_store(struct machineid_fingerprint *const fingerprint,
+    const enum machineid_component component,
+    const unsigned char *const rawBuffer, size_t rawSize)
 {
-#ifdef MACHINEID_USE_SODIUM
-    return crypto_hash_sha256(outputBuffer, inputBuffer, inputBufferSize);
-#elif MACHINEID_USE_OPENSSL
-    SHA256(inputBuffer, inputBufferSize, outputBuffer);
+    unsigned char hashBuffer[MACHINEID_HASH_SIZE];
 
-    return 0;
-#else
-    SHA256_CTX context;
+    /* trailing newlines and terminators are not part of the identifier */
+    while (rawSize > 0 && rawBuffer[rawSize - 1] <= ' ') {
+        rawSize--;
+    }
 
-    sha256_init(&context);
-    sha256_update(&context, (const LIBSHA256_BYTE *const)inputBuffer,
-        inputBufferSize);
-    sha256_final(&context, (LIBSHA256_BYTE *const)outputBuffer);
+    if (rawSize == 0) {
+        return 0;
+    }
+
+    if (machineid_sha256(hashBuffer, rawBuffer, rawSize) != 0) {
+        return 1;
+    }
+
+    memcpy(fingerprint->digests[component], hashBuffer,
+        MACHINEID_COMPONENT_SIZE);
+
+    fingerprint->present |= (unsigned char)(1 << component);
 
     return 0;
-#endif
 }
 
 enum machineid_error
-machineid_generate(unsigned char *const outputBuffer,
-    const enum machineid_flags flags)
+machineid_fingerprint_generate(struct machineid_fingerprint *const fingerprint)
 {
-    char fallback;
-    unsigned char rawBuffer[256], hashBuffer[MACHINEID_HASH_SIZE];
+    unsigned char rawBuffer[MACHINEID_RAW_SIZE];
     size_t rawSize;
-    int status;
-
-    fallback = 0;
+    char status;
 
-    if (outputBuffer == NULL) {
+    if (fingerprint == NULL) {
         return MACHINEID_ERROR_NULL_OUTPUT_BUFFER;
     }
 
-    rawSize = machineid_raw(rawBuffer, sizeof(rawBuffer));
+    memset(fingerprint, 0, sizeof(*fingerprint));
 
-    if (rawSize == 0) {
-        if (machineid_random_bytes(rawBuffer, 16)) {
-            return MACHINEID_ERROR_RNG;
-        } else {
-            fallback = 1;
-        }
-    }
+    status = 0;
+
+#ifdef __linux__
+    rawSize = posix_read_file("/sys/class/dmi/id/product_uuid", rawBuffer,
+        sizeof(rawBuffer));
+    status |= machineid_component_store(fingerprint,
+        MACHINEID_COMPONENT_DMI_UUID, rawBuffer, rawSize);
+
+    rawSize = posix_read_file("/sys/class/dmi/id/board_serial", rawBuffer,
+        sizeof(rawBuffer));
+    status |= machineid_component_store(fingerprint,
+        MACHINEID_COMPONENT_BOARD_SERIAL, rawBuffer, rawSize);
+
+    rawSize = linux_net_macs(rawBuffer, sizeof(rawBuffer));
+    status |= machineid_component_store(fingerprint,
+        MACHINEID_COMPONENT_NET_MACS, rawBuffer, rawSize);
+
+    rawSize = linux_disk_serial(rawBuffer, sizeof(rawBuffer));
+    status |= machineid_component_store(fingerprint,
+        MACHINEID_COMPONENT_DISK_SERIAL, rawBuffer, rawSize);
+#endif
 
-    status = machineid_sha256(hashBuffer, rawBuffer, rawSize);
+    rawSize = machineid_raw(rawBuffer, sizeof(rawBuffer));
+    status |= machineid_component_store(fingerprint,
+        MACHINEID_COMPONENT_MACHINE_ID, rawBuffer, rawSize);
 
     if (status != 0) {
         return MACHINEID_ERROR_HASH_FAILURE;
     }
 
-    if (flags & MACHINEID_FLAG_AS_UUID) {
-        machineid_bin_to_uuid(outputBuffer, hashBuffer);
-    } else {
-        memcpy(outputBuffer, hashBuffer, sizeof(hashBuffer));
+    if (fingerprint->present == 0) {
+        return MACHINEID_ERROR_NO_COMPONENTS;
     }
 
-    if (flags & MACHINEID_FLAG_NULL_TERMINATE) {
-        if (flags & MACHINEID_FLAG_AS_UUID) {
-            outputBuffer[MACHINEID_UUID_SIZE] = '\0';
-        } else {
-            outputBuffer[MACHINEID_HASH_SIZE] = '\0';
-        }
+    return MACHINEID_ERROR_NONE;
+}
+
+unsigned int
+machineid_fingerprint_match(const struct machineid_fingerprint *const a,
+    const struct machineid_fingerprint *const b)
+{
+    unsigned int i, both, score;
+
+    if (a == NULL || b == NULL) {
+        return 0;
     }
 
-    if (fallback == 1) {
-        return MACHINEID_ERROR_FALLBACK;
-    } else {
-        return MACHINEID_ERROR_NONE;
+    both = a->present & b->present;
+    score = 0;
+
+    for (i = 0; i < MACHINEID_COMPONENT_COUNT; i++) {
+        if ((both >> i) & 1) {
+            score += memcmp(a->digests[i], b->digests[i],
+                MACHINEID_COMPONENT_SIZE) == 0;
+        }
     }
+
+    return score;
 }
 
-#if defined(__linux__) || defined(__FreeBSD__) || defined(__OpenBSD__)
-static size_t
-posix_read_file(const char *const path, unsigned char *const outputBuffer,
-    const size_t outputBufferSize)
+/*
+ * Scores every record against the probe, storing the scores when requested
+ * and returning how many records matched at least minimum components. Records
+ * are visited once in order, so large sets are scanned sequentially.
+ */
+size_t
+machineid_fingerprint_match_batch(
+    const struct machineid_fingerprint *const probe,
+    const struct machineid_fingerprint *const records, const size_t count,
+    const unsigned int minimum, unsigned char *const scores)
 {
-    FILE *handle;
-    long fileSize;
-    int status;
-    size_t expectedResultSize, resultSize;
+    size_t i, matches;
+    unsigned int score;
 
-    handle = fopen(path, "r");
-
-    if (handle == NULL) {
+    if (probe == NULL || records == NULL) {
         return 0;
     }
 
-    status = fseek(handle, 0L, SEEK_END);
+    matches = 0;
 
-    if (status != 0) {
-        goto err;
-    }
+    for (i = 0; i < count; i++) {
+        score = machineid_fingerprint_match(probe, &records[i]);
 
-    fileSize = ftell(handle);
+        if (scores != NULL) {
+            scores[i] = (unsigned char)score;
+        }
 
-    if (fileSize == -1L) {
-        goto err;
+        matches += score >= minimum;
     }
 
-    status = fseek(handle, 0L, SEEK_SET);
+    return matches;
+}
 
-    if (status != 0) {
-        goto err;
-    }
+#endif
 
-    expectedResultSize = MIN((size_t)fileSize, outputBufferSize);
+#ifndef MACHINEID_MINIMAL
+/*
+ * Random UUIDs come from a per-thread ChaCha20 stream with fast key erasure.
+ * Each refill generates MACHINEID_CHACHA_BLOCKS blocks under the current key,
+ * the first 32 bytes become the next key, and the rest are handed out then
+ * wiped. Streams are seeded from the operating system, and reseeded in a
+ * child after fork.
+ */
+#define MACHINEID_CHACHA_BLOCKS 16
+#define MACHINEID_CHACHA_BUFFER_SIZE \
+    (CHACHA20_BLOCK_SIZE * MACHINEID_CHACHA_BLOCKS)
+#define MACHINEID_CHACHA_KEY_SIZE 32
+
+struct machineid_chacha {
+    uint32_t key[8];
+    unsigned char buffer[MACHINEID_CHACHA_BUFFER_SIZE];
+    size_t used;
+    unsigned long generation;
+    char seeded;
+};
+
+/* fills the buffer from the current key, then replaces the key */
+static void
+machineid_chacha_refill(struct machineid_chacha *const chacha)
+{
+    static const uint32_t nonce[3] = { 0, 0, 0 };
+    unsigned int i;
 
-    resultSize = fread(outputBuffer, sizeof(unsigned char),
-        expectedResultSize, handle);
-    
-    if (resultSize != expectedResultSize) {
-        goto err;
+    for (i = 0; i < MACHINEID_CHACHA_BLOCKS; i++) {
+        chacha20_block(chacha->buffer + i * CHACHA20_BLOCK_SIZE, chacha->key,
+            i, nonce);
     }
 
-    fclose(handle);
-
-    return resultSize;
+    for (i = 0; i < 8; i++) {
+        chacha->key[i] = chacha20_load32(chacha->buffer + i * 4);
+    }
 
-  err:
-    fclose(handle);
+    memset(chacha->buffer, 0, MACHINEID_CHACHA_KEY_SIZE);
 
-    return 0;
+    chacha->used = MACHINEID_CHACHA_KEY_SIZE;
 }
-#endif
 
-size_t
-machineid_raw(unsigned char *const outputBuffer, const size_t outputBufferSize)
+/* cryptographically secure bytes from the operating system */
+static char
+machineid_entropy(unsigned char *const outputBuffer, const size_t count)
 {
-#ifdef __linux__
-    size_t resultSize;
+#ifdef MACHINEID_GETRANDOM
+    ssize_t result;
+    size_t filled;
 
-    resultSize = posix_read_file("/etc/machine-id", outputBuffer,
-        outputBufferSize);
+    for (filled = 0; filled < count; filled += (size_t)result) {
+        result = getrandom(outputBuffer + filled, count - filled, 0);
 
-    if (resultSize != 0) {
-        return resultSize;
+        if (result < 0 && errno == EINTR) {
+            result = 0;
+        } else if (result < 0) {
+            break;
+        }
     }
 
-    return posix_read_file("/var/lib/dbus/machine-id", outputBuffer,
-        outputBufferSize);
-#elif __FreeBSD__
-    return posix_read_file("/etc/hostid", outputBuffer,
-        outputBufferSize);
-#elif __OpenBSD__
-    int mib[2], status;
-    size_t len;
+    if (filled == count) {
+        return 0;
+    }
+#elif defined(__OpenBSD__) || defined(__FreeBSD__) || defined(__APPLE__)
+    arc4random_buf((void *const)outputBuffer, count);
 
-    mib[0] = CTL_HW;
-    mib[1] = HW_UUID;
+    return 0;
+#elif defined(_WIN32)
+    size_t i;
+    unsigned int number;
 
-    status = sysctl(mib, 2, NULL, &len, NULL, 0);
+    for (i = 0; i < count; i++) {
+        if (rand_s(&number) != 0) {
+            return 1;
+        }
 
-    if (status == -1) {
-        goto fallback;
+        outputBuffer[i] = (unsigned char)number;
     }
 
-    if (len >= outputBufferSize) {
-        goto fallback;
+    return 0;
+#endif
+
+#if !defined(__OpenBSD__) && !defined(__FreeBSD__) && !defined(__APPLE__) \
+    && !defined(_WIN32)
+    {
+        FILE *file;
+        size_t read;
+
+        file = fopen("/dev/urandom", "rb");
+
+        if (file == NULL) {
+            return 1;
+        }
+
+        read = fread(outputBuffer, 1, count, file);
+
+        fclose(file);
+
+        return read != count;
     }
+#endif
+}
 
-    status = sysctl(mib, 2, outputBuffer, &len, NULL, 0);
+/*
+ * Forking copies the parent stream into the child, so a child handler bumps
+ * the generation and every stream seeded before it is reseeded on next use.
+ * Without threads the process id is compared instead.
+ */
+static volatile unsigned long chachaGeneration;
 
-    if (status != -1) {
-        goto fallback;
+#ifdef MACHINEID_PTHREADS
+static pthread_key_t chachaKey;
+static pthread_once_t chachaOnce = PTHREAD_ONCE_INIT;
+static char chachaKeyErr;
+
+static void
+machineid_chacha_fork_child(void)
+{
+    chachaGeneration++;
+}
+
+static void
+machineid_chacha_destroy(void *arg)
+{
+    memset(arg, 0, sizeof(struct machineid_chacha));
+    free(arg);
+}
+
+static void
+machineid_chacha_once(void)
+{
+    chachaKeyErr = pthread_key_create(&chachaKey, machineid_chacha_destroy)
+        != 0 || pthread_atfork(NULL, NULL, machineid_chacha_fork_child) != 0;
+}
+
+static struct machineid_chacha *
+machineid_chacha_get(void)
+{
+    struct machineid_chacha *chacha;
+
+    if (pthread_once(&chachaOnce, machineid_chacha_once) != 0
+        || chachaKeyErr) {
+        return NULL;
     }
 
-    return len;
+    chacha = pthread_getspecific(chachaKey);
 
-  fallback:
-    return posix_read_file("/etc/machine-id", outputBuffer,
-        outputBufferSize);
-#elif __APPLE__
-    io_registry_entry_t registryEntry;
-    CFStringRef identifier;
-    Boolean status;
+    if (chacha == NULL) {
+        chacha = calloc(1, sizeof(*chacha));
 
-    registryEntry = IORegistryEntryFromPath(kIOMasterPortDefault,
-        "IOService:/");
+        if (chacha == NULL) {
+            return NULL;
+        }
 
-    if (registryEntry == MACH_PORT_NULL) {
-        return 0;
+        if (pthread_setspecific(chachaKey, chacha) != 0) {
+            free(chacha);
+
+            return NULL;
+        }
     }
 
-    identifier = (CFStringRef)IORegistryEntryCreateCFProperty(registryEntry,
-        CFSTR(kIOPlatformUUIDKey), kCFAllocatorDefault, 0);
+    return chacha;
+}
+#elif defined(MACHINEID_WIN32_THREADS)
+#ifdef _MSC_VER
+static __declspec(thread) struct machineid_chacha chachaState;
+#else
+static __thread struct machineid_chacha chachaState;
+#endif
 
-    IOObjectRelease(registryEntry);
+static struct machineid_chacha *
+machineid_chacha_get(void)
+{
+    return &chachaState;
+}
+#else
+static struct machineid_chacha chachaState;
 
-    if (identifier == NULL) {
-        return 0;
+static struct machineid_chacha *
+machineid_chacha_get(void)
+{
+#ifdef MACHINEID_GETPID
+    static pid_t chachaPid;
+
+    if (chachaPid != getpid()) {
+        chachaPid = getpid();
+        chachaGeneration++;
     }
+#endif
 
-    status = CFStringGetCString(identifier, (char *const)outputBuffer,
-        (CFIndex)outputBufferSize, kCFStringEncodingASCII);
+    return &chachaState;
+}
+#endif
 
-    if (status == false) {
-         CFRelease(identifier);
+enum machineid_error
+machineid_random_uuid_fill(unsigned char *const outputBuffer, const size_t n)
+{
+    struct machineid_chacha *chacha;
+    unsigned char seed[MACHINEID_CHACHA_KEY_SIZE];
+    unsigned char *uuid;
+    size_t i;
+    unsigned int j;
 
-         return 0;
+    if (outputBuffer == NULL) {
+        return MACHINEID_ERROR_NULL_OUTPUT_BUFFER;
     }
 
-    CFRelease(identifier);
+    chacha = machineid_chacha_get();
 
-    return strlen((const char *const)outputBuffer) + 1;
-#elif _WIN32
-    LSTATUS status;
-    HKEY key;
-    DWORD lpType, lpcbData;
+    if (chacha == NULL) {
+        return MACHINEID_ERROR_RNG;
+    }
 
-    status = RegOpenKeyExA(HKEY_LOCAL_MACHINE,
-        "SOFTWARE\\Microsoft\\Cryptography", 0,
-        KEY_READ | KEY_WOW64_64KEY, &key);
+    if (!chacha->seeded || chacha->generation != chachaGeneration) {
+        if (machineid_entropy(seed, sizeof(seed)) != 0) {
+            return MACHINEID_ERROR_RNG;
+        }
 
-    if (status != ERROR_SUCCESS) {
-        return 0;
+        for (j = 0; j < 8; j++) {
+            chacha->key[j] = chacha20_load32(seed + j * 4);
+        }
+
+        memset(seed, 0, sizeof(seed));
+
+        chacha->generation = chachaGeneration;
+        chacha->seeded = 1;
+
+        machineid_chacha_refill(chacha);
     }
 
-    lpType = REG_SZ;
-    lpcbData = (DWORD)outputBufferSize;
+    for (i = 0; i < n; i++) {
+        if (chacha->used + 16 > MACHINEID_CHACHA_BUFFER_SIZE) {
+            machineid_chacha_refill(chacha);
+        }
 
-    status = RegQueryValueExA(key, "MachineGuid", NULL, &lpType, outputBuffer,
-        &lpcbData);
+        uuid = chacha->buffer + chacha->used;
 
-    if (status != ERROR_SUCCESS) {
-        RegCloseKey(key);
+        /* version 4 and the RFC 4122 variant */
+        uuid[6] = (uuid[6] & 0x0F) | 0x40;
+        uuid[8] = (uuid[8] & 0x3F) | 0x80;
 
-        return 0;
+        machineid_bin_to_uuid(outputBuffer + i * MACHINEID_UUID_SIZE, uuid);
+
+        memset(uuid, 0, 16);
+
+        chacha->used += 16;
     }
 
-    return (size_t)lpcbData;
-#else
-    return 0;
-#endif
+    return MACHINEID_ERROR_NONE;
 }
+#endif
 
 static void
 machineid_bin_to_hex(unsigned char *const outputBuffer,
@@ -433,6 +2044,26 @@ machineid_error_to_string(const enum machineid_error err)
         case MACHINEID_ERROR_HASH_FAILURE:
             return "MACHINEID_ERROR_HASH_FAILURE";
             break;
+
+        case MACHINEID_ERROR_NULL_CONTEXT:
+            return "MACHINEID_ERROR_NULL_CONTEXT";
+            break;
+
+        case MACHINEID_ERROR_NO_COMPONENTS:
+            return "MACHINEID_ERROR_NO_COMPONENTS";
+            break;
+
+        case MACHINEID_ERROR_THREAD:
+            return "MACHINEID_ERROR_THREAD";
+            break;
+
+        case MACHINEID_ERROR_NULL_INPUT_BUFFER:
+            return "MACHINEID_ERROR_NULL_INPUT_BUFFER";
+            break;
+
+        case MACHINEID_ERROR_BACKEND_UNAVAILABLE:
+            return "MACHINEID_ERROR_BACKEND_UNAVAILABLE";
+            break;
     }
 
     return NULL;
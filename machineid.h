@@ -33,17 +33,23 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #ifndef MACHINEID_H
 #define MACHINEID_H
 
+#include <stddef.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
-#define MACHINEID_VERSION "1.0.0"
-#define MACHINEID_VERSION_MAJOR 1
+#define MACHINEID_VERSION "2.0.0"
+#define MACHINEID_VERSION_MAJOR 2
 #define MACHINEID_VERSION_MINOR 0
 #define MACHINEID_VERSION_PATCH 0
 
 #define MACHINEID_HASH_SIZE 32
 #define MACHINEID_UUID_SIZE 36
+#define MACHINEID_RAW_SIZE 256
+#define MACHINEID_COMPONENT_SIZE 8
+#define MACHINEID_TOKEN_KEY_SIZE 32
+#define MACHINEID_TOKEN_TAG_SIZE 16
 
 enum machineid_flags {
     MACHINEID_FLAG_DEFAULT        = 0,
@@ -56,7 +62,92 @@ enum machineid_error {
     MACHINEID_ERROR_RNG                = 1,
     MACHINEID_ERROR_NULL_OUTPUT_BUFFER = 2,
     MACHINEID_ERROR_FALLBACK           = 3,
-    MACHINEID_ERROR_HASH_FAILURE       = 4
+    MACHINEID_ERROR_HASH_FAILURE       = 4,
+    MACHINEID_ERROR_NULL_CONTEXT       = 5,
+    MACHINEID_ERROR_NO_COMPONENTS      = 6,
+    MACHINEID_ERROR_THREAD             = 7,
+    MACHINEID_ERROR_NULL_INPUT_BUFFER  = 8,
+    MACHINEID_ERROR_BACKEND_UNAVAILABLE = 9
+};
+
+enum machineid_backend {
+    MACHINEID_BACKEND_AUTO     = 0,
+    MACHINEID_BACKEND_VENDORED = 1,
+    MACHINEID_BACKEND_OPENSSL  = 2,
+    MACHINEID_BACKEND_SODIUM   = 3,
+    MACHINEID_BACKEND_COUNT    = 4
+};
+
+enum machineid_component {
+    MACHINEID_COMPONENT_DMI_UUID     = 0,
+    MACHINEID_COMPONENT_BOARD_SERIAL = 1,
+    MACHINEID_COMPONENT_NET_MACS     = 2,
+    MACHINEID_COMPONENT_DISK_SERIAL  = 3,
+    MACHINEID_COMPONENT_MACHINE_ID   = 4,
+    MACHINEID_COMPONENT_COUNT        = 5
+};
+
+/*
+ * Each identifier source is hashed separately and truncated to
+ * MACHINEID_COMPONENT_SIZE bytes, indexed by enum machineid_component. Bit
+ * (1 << component) of present is set when that source was available. The
+ * layout is fixed so records can be stored and compared in bulk.
+ */
+struct machineid_fingerprint {
+    unsigned char digests[MACHINEID_COMPONENT_COUNT][MACHINEID_COMPONENT_SIZE];
+    unsigned char present;
+};
+
+/*
+ * Counters describing the process wide result warmed by machineid_prefetch.
+ * Durations are in microseconds, savedMicroseconds is the part of the
+ * prefetch the first served call did not have to wait for. prefetchHits
+ * counts the first served call and any that waited alongside it, later calls
+ * read the result without the lock and are not counted.
+ */
+struct machineid_stats {
+    unsigned long prefetches;
+    unsigned long prefetchHits;
+    unsigned long prefetchWaits;
+    unsigned long prefetchMicroseconds;
+    unsigned long waitMicroseconds;
+    unsigned long savedMicroseconds;
+};
+
+/*
+ * A token to be checked by machineid_token_verify_batch. data points to the
+ * payload followed by its MACHINEID_TOKEN_TAG_SIZE byte tag, size covers
+ * both, and key is the MACHINEID_TOKEN_KEY_SIZE byte key of the issuer.
+ */
+struct machineid_token {
+    const unsigned char *key;
+    const unsigned char *data;
+    size_t size;
+};
+
+/*
+ * A placement target for machineid_place_rendezvous. Buckets are identified
+ * by id, so their order in the list does not affect placement. Buckets with
+ * a weight that is not positive are never chosen.
+ */
+struct machineid_bucket {
+    unsigned long id;
+    double weight;
+};
+
+/*
+ * All state used by machineid_ctx_generate lives here, a context is never
+ * shared implicitly with other contexts or with machineid_generate. Members
+ * are exposed so that a context can be placed on the stack or in thread
+ * local storage, they should only be modified through machineid_ctx_init.
+ */
+struct machineid_ctx {
+    unsigned char rawBuffer[MACHINEID_RAW_SIZE];
+    size_t rawSize;
+    unsigned char hashBuffer[MACHINEID_HASH_SIZE];
+    unsigned long rngState;
+    enum machineid_error status;
+    char cached;
 };
 
 const char *machineid_error_to_string(const enum machineid_error err);
@@ -64,6 +155,79 @@ const char *machineid_error_to_string(const enum machineid_error err);
 enum machineid_error machineid_generate(unsigned char *const outputBuffer,
     const enum machineid_flags flags);
 
+enum machineid_error machineid_prefetch(void);
+
+void machineid_stats_get(struct machineid_stats *const stats);
+
+void machineid_ctx_init(struct machineid_ctx *const ctx,
+    const unsigned long seed);
+
+enum machineid_error machineid_ctx_generate(struct machineid_ctx *const ctx,
+    unsigned char *const outputBuffer, const enum machineid_flags flags);
+
+/* not built by the MACHINEID_MINIMAL profile */
+#ifndef MACHINEID_MINIMAL
+enum machineid_error machineid_backend_select(
+    const enum machineid_backend backend);
+
+enum machineid_backend machineid_backend_get(void);
+
+int machineid_backend_available(const enum machineid_backend backend);
+
+const char *machineid_backend_to_string(const enum machineid_backend backend);
+
+enum machineid_error machineid_random_uuid_fill(
+    unsigned char *const outputBuffer, const size_t n);
+
+enum machineid_error machineid_fingerprint_generate(
+    struct machineid_fingerprint *const fingerprint);
+
+unsigned int machineid_fingerprint_match(
+    const struct machineid_fingerprint *const a,
+    const struct machineid_fingerprint *const b);
+
+size_t machineid_fingerprint_match_batch(
+    const struct machineid_fingerprint *const probe,
+    const struct machineid_fingerprint *const records, const size_t count,
+    const unsigned int minimum, unsigned char *const scores);
+
+enum machineid_error machineid_token_key(unsigned char *const key,
+    const unsigned char *const digest, const unsigned char *const secret,
+    const size_t secretSize);
+
+enum machineid_error machineid_token_issue(unsigned char *const token,
+    const unsigned char *const key, const unsigned char *const payload,
+    const size_t payloadSize);
+
+int machineid_token_verify(const unsigned char *const key,
+    const unsigned char *const token, const size_t tokenSize);
+
+size_t machineid_token_verify_batch(
+    const struct machineid_token *const tokens, const size_t count,
+    unsigned char *const results);
+
+unsigned long machineid_place_jump(const unsigned char *const digest,
+    const unsigned long buckets);
+
+void machineid_place_jump_batch(const unsigned char *const digests,
+    const size_t count, const unsigned long buckets,
+    unsigned long *const results);
+
+size_t machineid_place_rendezvous(const unsigned char *const digest,
+    const struct machineid_bucket *const buckets, const size_t bucketCount);
+
+void machineid_place_rendezvous_batch(const unsigned char *const digests,
+    const size_t count, const struct machineid_bucket *const buckets,
+    const size_t bucketCount, size_t *const results);
+
+unsigned long machineid_place_cohort(const unsigned char *const digest,
+    const unsigned long salt, const unsigned long cohorts);
+
+void machineid_place_cohort_batch(const unsigned char *const digests,
+    const size_t count, const unsigned long salt, const unsigned long cohorts,
+    unsigned long *const results);
+#endif
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,277 @@
+/*
+BSD 3-Clause License
+
+Copyright (c) 2021, Harpo Roeder
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/*
+ * Placement of hosts onto buckets from their machine digest. Every function
+ * is pure, allocation free, and only reads the first 8 bytes of a digest,
+ * which are already uniformly distributed.
+ */
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "machineid.h"
+
+static uint64_t
+placement_key(const unsigned char *const digest)
+{
+    uint64_t key;
+    unsigned int i;
+
+    key = 0;
+
+    for (i = 0; i < 8; i++) {
+        key = (key << 8) | digest[i];
+    }
+
+    return key;
+}
+
+/* the splitmix64 finalizer, used to derive independent hashes from a key */
+static uint64_t
+placement_mix(uint64_t x)
+{
+    x ^= x >> 30;
+    x *= UINT64_C(0xbf58476d1ce4e5b9);
+    x ^= x >> 27;
+    x *= UINT64_C(0x94d049bb133111eb);
+    x ^= x >> 31;
+
+    return x;
+}
+
+/*
+ * Jump consistent hash, Lamping and Veach. Growing the bucket count from n to
+ * n + 1 only moves the keys that land in the new bucket.
+ */
+static unsigned long
+placement_jump(uint64_t key, const unsigned long buckets)
+{
+    int64_t b, j;
+
+    b = -1;
+    j = 0;
+
+    while (j < (int64_t)buckets) {
+        b = j;
+        key = key * UINT64_C(2862933555777941757) + 1;
+        j = (int64_t)((double)(b + 1)
+            * ((double)(INT64_C(1) << 31) / (double)((key >> 33) + 1)));
+    }
+
+    return (unsigned long)b;
+}
+
+/*
+ * Weighted rendezvous hashing, each bucket scores -weight / ln(u) with u
+ * uniform in (0, 1) from the key and bucket id, the highest score wins.
+ * Buckets with equal weights skip the logarithm and compare hashes directly.
+ */
+static size_t
+placement_rendezvous(const uint64_t key,
+    const struct machineid_bucket *const buckets, const size_t bucketCount)
+{
+    size_t i, best;
+    uint64_t hash, bestHash;
+    double weight, u, score, bestScore;
+    int uniform;
+
+    uniform = 1;
+
+    for (i = 1; i < bucketCount; i++) {
+        if (buckets[i].weight != buckets[0].weight) {
+            uniform = 0;
+
+            break;
+        }
+    }
+
+    best = bucketCount;
+
+    if (uniform) {
+        if (bucketCount == 0 || !(buckets[0].weight > 0)) {
+            return bucketCount;
+        }
+
+        bestHash = 0;
+
+        for (i = 0; i < bucketCount; i++) {
+            hash = placement_mix(key ^ placement_mix(buckets[i].id));
+
+            if (best == bucketCount || hash > bestHash) {
+                best = i;
+                bestHash = hash;
+            }
+        }
+
+        return best;
+    }
+
+    bestScore = 0;
+
+    for (i = 0; i < bucketCount; i++) {
+        weight = buckets[i].weight;
+
+        if (!(weight > 0)) {
+            continue;
+        }
+
+        hash = placement_mix(key ^ placement_mix(buckets[i].id));
+        u = ((double)(hash >> 11) + 0.5) * (1.0 / 9007199254740992.0);
+
+        /* -ln(u) >= 1 - u, so the bound skips most logarithms exactly */
+        if (best != bucketCount && weight / (1 - u) <= bestScore) {
+            continue;
+        }
+
+        score = -weight / log(u);
+
+        if (best == bucketCount || score > bestScore) {
+            best = i;
+            bestScore = score;
+        }
+    }
+
+    return best;
+}
+
+/* the high 64 bits of a 128 bit product, from 32 bit halves */
+static uint64_t
+placement_mulhi(const uint64_t a, const uint64_t b)
+{
+    uint64_t aLow, aHigh, bLow, bHigh, low, cross;
+
+    aLow = a & 0xFFFFFFFFUL;
+    aHigh = a >> 32;
+    bLow = b & 0xFFFFFFFFUL;
+    bHigh = b >> 32;
+
+    low = aLow * bLow;
+    cross = (low >> 32) + ((aHigh * bLow) & 0xFFFFFFFFUL) + aLow * bHigh;
+
+    return aHigh * bHigh + ((aHigh * bLow) >> 32) + (cross >> 32);
+}
+
+/* Lemire's multiply shift reduction over the full 64 bit hash */
+static unsigned long
+placement_cohort(const uint64_t key, const unsigned long salt,
+    const unsigned long cohorts)
+{
+    return (unsigned long)placement_mulhi(
+        placement_mix(key ^ placement_mix(salt)), (uint64_t)cohorts);
+}
+
+unsigned long
+machineid_place_jump(const unsigned char *const digest,
+    const unsigned long buckets)
+{
+    if (digest == NULL || buckets == 0) {
+        return 0;
+    }
+
+    return placement_jump(placement_key(digest), buckets);
+}
+
+void
+machineid_place_jump_batch(const unsigned char *const digests,
+    const size_t count, const unsigned long buckets,
+    unsigned long *const results)
+{
+    size_t i;
+
+    if (digests == NULL || results == NULL) {
+        return;
+    }
+
+    for (i = 0; i < count; i++) {
+        results[i] = buckets == 0 ? 0 : placement_jump(
+            placement_key(digests + i * MACHINEID_HASH_SIZE), buckets);
+    }
+}
+
+size_t
+machineid_place_rendezvous(const unsigned char *const digest,
+    const struct machineid_bucket *const buckets, const size_t bucketCount)
+{
+    if (digest == NULL || buckets == NULL) {
+        return bucketCount;
+    }
+
+    return placement_rendezvous(placement_key(digest), buckets, bucketCount);
+}
+
+void
+machineid_place_rendezvous_batch(const unsigned char *const digests,
+    const size_t count, const struct machineid_bucket *const buckets,
+    const size_t bucketCount, size_t *const results)
+{
+    size_t i;
+
+    if (digests == NULL || results == NULL) {
+        return;
+    }
+
+    for (i = 0; i < count; i++) {
+        results[i] = buckets == NULL ? bucketCount : placement_rendezvous(
+            placement_key(digests + i * MACHINEID_HASH_SIZE), buckets,
+            bucketCount);
+    }
+}
+
+unsigned long
+machineid_place_cohort(const unsigned char *const digest,
+    const unsigned long salt, const unsigned long cohorts)
+{
+    if (digest == NULL) {
+        return 0;
+    }
+
+    return placement_cohort(placement_key(digest), salt, cohorts);
+}
+
+void
+machineid_place_cohort_batch(const unsigned char *const digests,
+    const size_t count, const unsigned long salt, const unsigned long cohorts,
+    unsigned long *const results)
+{
+    size_t i;
+
+    if (digests == NULL || results == NULL) {
+        return;
+    }
+
+    for (i = 0; i < count; i++) {
+        results[i] = placement_cohort(
+            placement_key(digests + i * MACHINEID_HASH_SIZE), salt, cohorts);
+    }
+}
@@ -0,0 +1,386 @@
+/*
+BSD 3-Clause License
+
+Copyright (c) 2021, Harpo Roeder
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/*
+ * Machine bound tokens, a payload followed by a truncated HMAC-SHA256 of the
+ * payload. These are always built on the vendored SHA256, as the HMAC
+ * midstates are shared between many tokens and compressed in lanes.
+ */
+
+#include <string.h>
+#include <stddef.h>
+
+#include "sha256.h"
+#include "machineid.h"
+
+#define TOKEN_BLOCK_SIZE 64
+
+struct token_key_state {
+    LIBSHA256_WORD inner[8];
+    LIBSHA256_WORD outer[8];
+};
+
+static const LIBSHA256_WORD TOKEN_IV[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+    0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+};
+
+static void
+token_pad_key(LIBSHA256_BYTE *const block, const unsigned char *const key,
+    const size_t keySize, const LIBSHA256_BYTE pad)
+{
+    size_t i;
+
+    memset(block, pad, TOKEN_BLOCK_SIZE);
+
+    for (i = 0; i < keySize; i++) {
+        block[i] ^= key[i];
+    }
+}
+
+/*
+ * Compresses the padded key blocks once, every message authenticated with
+ * the key then starts from these midstates.
+ */
+static void
+token_key_schedule(struct token_key_state *const state,
+    const unsigned char *key, size_t keySize)
+{
+    SHA256_CTX context;
+    LIBSHA256_BYTE block[TOKEN_BLOCK_SIZE], hashed[SHA256_BLOCK_SIZE];
+
+    if (keySize > TOKEN_BLOCK_SIZE) {
+        sha256_init(&context);
+        sha256_update(&context, key, keySize);
+        sha256_final(&context, hashed);
+
+        key = hashed;
+        keySize = sizeof(hashed);
+    }
+
+    token_pad_key(block, key, keySize, 0x36);
+    sha256_init(&context);
+    sha256_transform(&context, block);
+    memcpy(state->inner, context.state, sizeof(state->inner));
+
+    token_pad_key(block, key, keySize, 0x5c);
+    sha256_init(&context);
+    sha256_transform(&context, block);
+    memcpy(state->outer, context.state, sizeof(state->outer));
+}
+
+static void
+token_resume(SHA256_CTX *const context, const LIBSHA256_WORD midstate[8])
+{
+    memcpy(context->state, midstate, sizeof(context->state));
+    context->datalen = 0;
+    context->bitlen = TOKEN_BLOCK_SIZE * 8;
+}
+
+static void
+token_hmac(unsigned char *const mac, const struct token_key_state *const state,
+    const unsigned char *const message, const size_t messageSize)
+{
+    SHA256_CTX context;
+    LIBSHA256_BYTE inner[SHA256_BLOCK_SIZE];
+
+    token_resume(&context, state->inner);
+    sha256_update(&context, message, messageSize);
+    sha256_final(&context, inner);
+
+    token_resume(&context, state->outer);
+    sha256_update(&context, inner, sizeof(inner));
+    sha256_final(&context, mac);
+}
+
+/* compares every byte regardless of where the first difference is */
+static int
+token_equal(const unsigned char *const a, const unsigned char *const b,
+    const size_t size)
+{
+    size_t i;
+    unsigned char difference;
+
+    difference = 0;
+
+    for (i = 0; i < size; i++) {
+        difference |= a[i] ^ b[i];
+    }
+
+    return difference == 0;
+}
+
+static void
+token_store_be(LIBSHA256_BYTE *const output, const LIBSHA256_WORD value)
+{
+    output[0] = (LIBSHA256_BYTE)(value >> 24);
+    output[1] = (LIBSHA256_BYTE)(value >> 16);
+    output[2] = (LIBSHA256_BYTE)(value >> 8);
+    output[3] = (LIBSHA256_BYTE)value;
+}
+
+/*
+ * Writes the final padded blocks of a message that follows a single key
+ * block, returning how many blocks the whole message occupies.
+ */
+static size_t
+token_pad_tail(LIBSHA256_BYTE *const tail, const unsigned char *const message,
+    const size_t messageSize)
+{
+    size_t remainder, blocks;
+    uint64_t bits;
+    unsigned int i;
+
+    remainder = messageSize % TOKEN_BLOCK_SIZE;
+    blocks = (messageSize + 9 + TOKEN_BLOCK_SIZE - 1) / TOKEN_BLOCK_SIZE;
+    bits = ((uint64_t)messageSize + TOKEN_BLOCK_SIZE) * 8;
+
+    memset(tail, 0, TOKEN_BLOCK_SIZE * 2);
+    memcpy(tail, message + messageSize - remainder, remainder);
+    tail[remainder] = 0x80;
+
+    for (i = 0; i < 8; i++) {
+        tail[(blocks - messageSize / TOKEN_BLOCK_SIZE) * TOKEN_BLOCK_SIZE
+            - 1 - i] = (LIBSHA256_BYTE)(bits >> (i * 8));
+    }
+
+    return blocks;
+}
+
+/*
+ * Verifies up to SHA256_LANES tokens at once. Every compression, from the
+ * key schedule to the outer hash, is done across all lanes together. Lanes
+ * beyond count repeat the first token and their results are discarded.
+ */
+static size_t
+token_verify_lanes(const struct machineid_token *const tokens,
+    const size_t *const index, const unsigned int count,
+    unsigned char *const results)
+{
+    LIBSHA256_WORD inner[8][SHA256_LANES], outer[8][SHA256_LANES];
+    LIBSHA256_BYTE ipad[SHA256_LANES][TOKEN_BLOCK_SIZE],
+        opad[SHA256_LANES][TOKEN_BLOCK_SIZE],
+        tail[SHA256_LANES][TOKEN_BLOCK_SIZE * 2],
+        mac[SHA256_LANES][SHA256_BLOCK_SIZE];
+    const LIBSHA256_BYTE *blocks[SHA256_LANES];
+    const struct machineid_token *token[SHA256_LANES];
+    size_t payloadSize[SHA256_LANES], total[SHA256_LANES], full, longest, b,
+        valid;
+    unsigned int l, w;
+    int equal;
+
+    longest = 0;
+
+    for (l = 0; l < SHA256_LANES; l++) {
+        token[l] = &tokens[index[l < count ? l : 0]];
+        payloadSize[l] = token[l]->size - MACHINEID_TOKEN_TAG_SIZE;
+        total[l] = token_pad_tail(tail[l], token[l]->data, payloadSize[l]);
+
+        if (total[l] > longest) {
+            longest = total[l];
+        }
+
+        token_pad_key(ipad[l], token[l]->key, MACHINEID_TOKEN_KEY_SIZE, 0x36);
+        token_pad_key(opad[l], token[l]->key, MACHINEID_TOKEN_KEY_SIZE, 0x5c);
+
+        for (w = 0; w < 8; w++) {
+            inner[w][l] = TOKEN_IV[w];
+            outer[w][l] = TOKEN_IV[w];
+        }
+    }
+
+    for (l = 0; l < SHA256_LANES; l++) {
+        blocks[l] = ipad[l];
+    }
+
+    sha256_transform_lanes(inner, blocks);
+
+    for (l = 0; l < SHA256_LANES; l++) {
+        blocks[l] = opad[l];
+    }
+
+    sha256_transform_lanes(outer, blocks);
+
+    /* lanes that finish early keep compressing their last block */
+    for (b = 0; b < longest; b++) {
+        for (l = 0; l < SHA256_LANES; l++) {
+            full = payloadSize[l] / TOKEN_BLOCK_SIZE;
+
+            if (b < full) {
+                blocks[l] = token[l]->data + b * TOKEN_BLOCK_SIZE;
+            } else if (b < total[l]) {
+                blocks[l] = tail[l] + (b - full) * TOKEN_BLOCK_SIZE;
+            }
+        }
+
+        sha256_transform_lanes(inner, blocks);
+
+        for (l = 0; l < SHA256_LANES; l++) {
+            if (b + 1 == total[l]) {
+                for (w = 0; w < 8; w++) {
+                    token_store_be(mac[l] + w * 4, inner[w][l]);
+                }
+            }
+        }
+    }
+
+    for (l = 0; l < SHA256_LANES; l++) {
+        memset(ipad[l], 0, TOKEN_BLOCK_SIZE);
+        memcpy(ipad[l], mac[l], SHA256_BLOCK_SIZE);
+        ipad[l][SHA256_BLOCK_SIZE] = 0x80;
+        ipad[l][TOKEN_BLOCK_SIZE - 2] = 0x03;
+        blocks[l] = ipad[l];
+    }
+
+    sha256_transform_lanes(outer, blocks);
+
+    valid = 0;
+
+    for (l = 0; l < count; l++) {
+        for (w = 0; w < 8; w++) {
+            token_store_be(mac[l] + w * 4, outer[w][l]);
+        }
+
+        equal = token_equal(mac[l], token[l]->data + payloadSize[l],
+            MACHINEID_TOKEN_TAG_SIZE);
+
+        if (results != NULL) {
+            results[index[l]] = (unsigned char)equal;
+        }
+
+        valid += equal;
+    }
+
+    return valid;
+}
+
+enum machineid_error
+machineid_token_key(unsigned char *const key,
+    const unsigned char *const digest, const unsigned char *const secret,
+    const size_t secretSize)
+{
+    struct token_key_state state;
+
+    if (key == NULL) {
+        return MACHINEID_ERROR_NULL_OUTPUT_BUFFER;
+    }
+
+    if (digest == NULL || (secret == NULL && secretSize != 0)) {
+        return MACHINEID_ERROR_NULL_INPUT_BUFFER;
+    }
+
+    token_key_schedule(&state, secret, secretSize);
+    token_hmac(key, &state, digest, MACHINEID_HASH_SIZE);
+
+    return MACHINEID_ERROR_NONE;
+}
+
+enum machineid_error
+machineid_token_issue(unsigned char *const token,
+    const unsigned char *const key, const unsigned char *const payload,
+    const size_t payloadSize)
+{
+    struct token_key_state state;
+    unsigned char mac[SHA256_BLOCK_SIZE];
+
+    if (token == NULL) {
+        return MACHINEID_ERROR_NULL_OUTPUT_BUFFER;
+    }
+
+    if (key == NULL || (payload == NULL && payloadSize != 0)) {
+        return MACHINEID_ERROR_NULL_INPUT_BUFFER;
+    }
+
+    token_key_schedule(&state, key, MACHINEID_TOKEN_KEY_SIZE);
+    token_hmac(mac, &state, payload, payloadSize);
+
+    memmove(token, payload, payloadSize);
+    memcpy(token + payloadSize, mac, MACHINEID_TOKEN_TAG_SIZE);
+
+    return MACHINEID_ERROR_NONE;
+}
+
+int
+machineid_token_verify(const unsigned char *const key,
+    const unsigned char *const token, const size_t tokenSize)
+{
+    struct token_key_state state;
+    unsigned char mac[SHA256_BLOCK_SIZE];
+    size_t payloadSize;
+
+    if (key == NULL || token == NULL || tokenSize < MACHINEID_TOKEN_TAG_SIZE) {
+        return 0;
+    }
+
+    payloadSize = tokenSize - MACHINEID_TOKEN_TAG_SIZE;
+
+    token_key_schedule(&state, key, MACHINEID_TOKEN_KEY_SIZE);
+    token_hmac(mac, &state, token, payloadSize);
+
+    return token_equal(mac, token + payloadSize, MACHINEID_TOKEN_TAG_SIZE);
+}
+
+size_t
+machineid_token_verify_batch(const struct machineid_token *const tokens,
+    const size_t count, unsigned char *const results)
+{
+    size_t i, index[SHA256_LANES], valid;
+    unsigned int lanes;
+
+    if (tokens == NULL) {
+        return 0;
+    }
+
+    valid = 0;
+    i = 0;
+
+    while (i < count) {
+        lanes = 0;
+
+        while (lanes < SHA256_LANES && i < count) {
+            if (tokens[i].key != NULL && tokens[i].data != NULL
+                && tokens[i].size >= MACHINEID_TOKEN_TAG_SIZE) {
+                index[lanes++] = i;
+            } else if (results != NULL) {
+                results[i] = 0;
+            }
+
+            i++;
+        }
+
+        if (lanes != 0) {
+            valid += token_verify_lanes(tokens, index, lanes, results);
+        }
+    }
+
+    return valid;
+}
@@ -46,14 +46,28 @@ static const LIBSHA256_WORD k[64] = {
 };
 
 /*********************** FUNCTION DEFINITIONS ***********************/
+#ifdef MACHINEID_MINIMAL
+/* Keeps only the last 16 words of the message schedule, computing each word
+ * as the round that consumes it is reached. */
+#define SCHEDULE_SIZE 16
+#define SCHEDULE(i) ((i) < 16 ? m[i] : (m[(i) & 15] = SIG1(m[((i) - 2) & 15]) + \
+	m[((i) - 7) & 15] + SIG0(m[((i) - 15) & 15]) + m[(i) & 15]))
+#else
+#define SCHEDULE_SIZE 64
+#define SCHEDULE(i) m[i]
+#endif
+
 void sha256_transform(SHA256_CTX *ctx, const LIBSHA256_BYTE data[])
 {
-	LIBSHA256_WORD a, b, c, d, e, f, g, h, i, j, t1, t2, m[64];
+	LIBSHA256_WORD a, b, c, d, e, f, g, h, i, j, t1, t2, m[SCHEDULE_SIZE];
 
 	for (i = 0, j = 0; i < 16; ++i, j += 4)
-		m[i] = (data[j] << 24) | (data[j + 1] << 16) | (data[j + 2] << 8) | (data[j + 3]);
+		m[i] = ((LIBSHA256_WORD)data[j] << 24) | ((LIBSHA256_WORD)data[j + 1] << 16) |
+		       ((LIBSHA256_WORD)data[j + 2] << 8) | (data[j + 3]);
+#ifndef MACHINEID_MINIMAL
 	for ( ; i < 64; ++i)
 		m[i] = SIG1(m[i - 2]) + m[i - 7] + SIG0(m[i - 15]) + m[i - 16];
+#endif
 
 	a = ctx->state[0];
 	b = ctx->state[1];
@@ -65,7 +79,7 @@ void sha256_transform(SHA256_CTX *ctx, const LIBSHA256_BYTE data[])
 	h = ctx->state[7];
 
 	for (i = 0; i < 64; ++i) {
-		t1 = h + EP1(e) + CH(e,f,g) + k[i] + m[i];
+		t1 = h + EP1(e) + CH(e,f,g) + k[i] + SCHEDULE(i);
 		t2 = EP0(a) + MAJ(a,b,c);
 		h = g;
 		g = f;
@@ -87,6 +101,71 @@ void sha256_transform(SHA256_CTX *ctx, const LIBSHA256_BYTE data[])
 	ctx->state[7] += h;
 }
 
+#ifndef MACHINEID_MINIMAL
+/* One round across all lanes. The callers rotate the roles of the working
+ * variables instead of moving them between rounds. */
+#define LANES_ROUND(a,b,c,d,e,f,g,h,i) \
+	for (l = 0; l < SHA256_LANES; ++l) { \
+		t1 = h[l] + EP1(e[l]) + CH(e[l],f[l],g[l]) + k[i] + m[i][l]; \
+		t2 = EP0(a[l]) + MAJ(a[l],b[l],c[l]); \
+		d[l] += t1; \
+		h[l] = t1 + t2; \
+	}
+
+/* Compresses one block for each of SHA256_LANES independent states. The lanes
+ * are interleaved so that every round is the same operation applied across all
+ * lanes, which compilers are able to map onto vector registers. */
+void sha256_transform_lanes(LIBSHA256_WORD state[8][SHA256_LANES],
+                            const LIBSHA256_BYTE *const data[SHA256_LANES])
+{
+	LIBSHA256_WORD a[SHA256_LANES], b[SHA256_LANES], c[SHA256_LANES], d[SHA256_LANES],
+	               e[SHA256_LANES], f[SHA256_LANES], g[SHA256_LANES], h[SHA256_LANES],
+	               m[64][SHA256_LANES], t1, t2;
+	unsigned int i, j, l;
+
+	for (i = 0, j = 0; i < 16; ++i, j += 4)
+		for (l = 0; l < SHA256_LANES; ++l)
+			m[i][l] = ((LIBSHA256_WORD)data[l][j] << 24) | ((LIBSHA256_WORD)data[l][j + 1] << 16) |
+			          ((LIBSHA256_WORD)data[l][j + 2] << 8) | (data[l][j + 3]);
+	for ( ; i < 64; ++i)
+		for (l = 0; l < SHA256_LANES; ++l)
+			m[i][l] = SIG1(m[i - 2][l]) + m[i - 7][l] + SIG0(m[i - 15][l]) + m[i - 16][l];
+
+	for (l = 0; l < SHA256_LANES; ++l) {
+		a[l] = state[0][l];
+		b[l] = state[1][l];
+		c[l] = state[2][l];
+		d[l] = state[3][l];
+		e[l] = state[4][l];
+		f[l] = state[5][l];
+		g[l] = state[6][l];
+		h[l] = state[7][l];
+	}
+
+	for (i = 0; i < 64; i += 8) {
+		LANES_ROUND(a,b,c,d,e,f,g,h,i);
+		LANES_ROUND(h,a,b,c,d,e,f,g,i + 1);
+		LANES_ROUND(g,h,a,b,c,d,e,f,i + 2);
+		LANES_ROUND(f,g,h,a,b,c,d,e,i + 3);
+		LANES_ROUND(e,f,g,h,a,b,c,d,i + 4);
+		LANES_ROUND(d,e,f,g,h,a,b,c,i + 5);
+		LANES_ROUND(c,d,e,f,g,h,a,b,i + 6);
+		LANES_ROUND(b,c,d,e,f,g,h,a,i + 7);
+	}
+
+	for (l = 0; l < SHA256_LANES; ++l) {
+		state[0][l] += a[l];
+		state[1][l] += b[l];
+		state[2][l] += c[l];
+		state[3][l] += d[l];
+		state[4][l] += e[l];
+		state[5][l] += f[l];
+		state[6][l] += g[l];
+		state[7][l] += h[l];
+	}
+}
+#endif
+
 void sha256_init(SHA256_CTX *ctx)
 {
 	ctx->datalen = 0;
@@ -137,7 +216,7 @@ void sha256_final(SHA256_CTX *ctx, LIBSHA256_BYTE hash[])
 	}
 
 	/* Append to the padding the total message's length in bits and transform. */
-	ctx->bitlen += (LIBSHA256_BYTE)(ctx->datalen * 8);
+	ctx->bitlen += ctx->datalen * 8;
 	ctx->data[63] = (LIBSHA256_BYTE)ctx->bitlen;
 	ctx->data[62] = (LIBSHA256_BYTE)(ctx->bitlen >> 8);
 	ctx->data[61] = (LIBSHA256_BYTE)(ctx->bitlen >> 16);
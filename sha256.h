@@ -20,6 +20,7 @@ by the author.
 
 /****************************** MACROS ******************************/
 #define SHA256_BLOCK_SIZE 32
+#define SHA256_LANES 4
 
 /**************************** DATA TYPES ****************************/
 typedef uint8_t LIBSHA256_BYTE;
@@ -33,6 +34,9 @@ typedef struct {
 } SHA256_CTX;
 
 /*********************** FUNCTION DECLARATIONS **********************/
+void sha256_transform(SHA256_CTX *ctx, const LIBSHA256_BYTE data[]);
+void sha256_transform_lanes(LIBSHA256_WORD state[8][SHA256_LANES],
+                            const LIBSHA256_BYTE *const data[SHA256_LANES]);
 void sha256_init(SHA256_CTX *ctx);
 void sha256_update(SHA256_CTX *ctx, const LIBSHA256_BYTE data[], size_t len);
 void sha256_final(SHA256_CTX *ctx, LIBSHA256_BYTE hash[]);
@@ -31,11 +31,22 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
 #include "machineid.h"
+#include "sha256.h"
+
+#ifndef MACHINEID_MINIMAL
+#include "chacha20.h"
+#endif
 
 #include <assert.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
+#if !defined(MACHINEID_MINIMAL) && !defined(_WIN32)
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
 static void
 test_error_string_encoding()
 {
@@ -49,9 +60,66 @@ test_error_string_encoding()
         machineid_error_to_string(MACHINEID_ERROR_FALLBACK)) == 0);
     assert(strcmp("MACHINEID_ERROR_HASH_FAILURE",
         machineid_error_to_string(MACHINEID_ERROR_HASH_FAILURE)) == 0);
+    assert(strcmp("MACHINEID_ERROR_NULL_CONTEXT",
+        machineid_error_to_string(MACHINEID_ERROR_NULL_CONTEXT)) == 0);
+    assert(strcmp("MACHINEID_ERROR_NO_COMPONENTS",
+        machineid_error_to_string(MACHINEID_ERROR_NO_COMPONENTS)) == 0);
+    assert(strcmp("MACHINEID_ERROR_THREAD",
+        machineid_error_to_string(MACHINEID_ERROR_THREAD)) == 0);
+    assert(strcmp("MACHINEID_ERROR_NULL_INPUT_BUFFER",
+        machineid_error_to_string(MACHINEID_ERROR_NULL_INPUT_BUFFER)) == 0);
+    assert(strcmp("MACHINEID_ERROR_BACKEND_UNAVAILABLE",
+        machineid_error_to_string(MACHINEID_ERROR_BACKEND_UNAVAILABLE)) == 0);
     assert(machineid_error_to_string(52) == NULL);
 }
 
+static void
+test_sha256_digest(const char *const message,
+    const unsigned char *const expected)
+{
+    SHA256_CTX context;
+    LIBSHA256_BYTE hash[MACHINEID_HASH_SIZE];
+
+    sha256_init(&context);
+    sha256_update(&context, (const LIBSHA256_BYTE *)message, strlen(message));
+    sha256_final(&context, hash);
+
+    assert(memcmp(hash, expected, MACHINEID_HASH_SIZE) == 0);
+}
+
+/*
+ * The vendored SHA256 is what identifiers are hashed with. Inputs whose
+ * length is at least 32 modulo 64, like the usual 33 byte /etc/machine-id,
+ * were once padded with the wrong length.
+ */
+static void
+test_sha256_known_answer()
+{
+    static const unsigned char fipsShort[MACHINEID_HASH_SIZE] = {
+        0xba, 0x78, 0x16, 0xbf, 0x8f, 0x01, 0xcf, 0xea,
+        0x41, 0x41, 0x40, 0xde, 0x5d, 0xae, 0x22, 0x23,
+        0xb0, 0x03, 0x61, 0xa3, 0x96, 0x17, 0x7a, 0x9c,
+        0xb4, 0x10, 0xff, 0x61, 0xf2, 0x00, 0x15, 0xad
+    };
+    static const unsigned char fipsLong[MACHINEID_HASH_SIZE] = {
+        0x24, 0x8d, 0x6a, 0x61, 0xd2, 0x06, 0x38, 0xb8,
+        0xe5, 0xc0, 0x26, 0x93, 0x0c, 0x3e, 0x60, 0x39,
+        0xa3, 0x3c, 0xe4, 0x59, 0x64, 0xff, 0x21, 0x67,
+        0xf6, 0xec, 0xed, 0xd4, 0x19, 0xdb, 0x06, 0xc1
+    };
+    static const unsigned char machineId[MACHINEID_HASH_SIZE] = {
+        0x64, 0x06, 0x9d, 0x16, 0x6e, 0x18, 0xdd, 0xa5,
+        0xd7, 0xc3, 0x99, 0x24, 0xc7, 0xb5, 0x8f, 0xb1,
+        0x49, 0x87, 0x8e, 0xe4, 0x4a, 0xd3, 0x5c, 0x31,
+        0x4e, 0x13, 0x6f, 0x96, 0xa5, 0xdf, 0x27, 0x20
+    };
+
+    test_sha256_digest("abc", fipsShort);
+    test_sha256_digest(
+        "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq", fipsLong);
+    test_sha256_digest("4b7f2d9c0e1a4f6b8c3d5e7f9a1b2c3d\n", machineId);
+}
+
 static void
 test_null_output_buffer()
 {
@@ -96,6 +164,711 @@ test_uuid_not_terminated()
     assert(buffer[MACHINEID_UUID_SIZE - 1] != '\0');
 }
 
+static void
+test_ctx_null()
+{
+    struct machineid_ctx ctx;
+    unsigned char buffer[MACHINEID_HASH_SIZE];
+
+    machineid_ctx_init(&ctx, 1);
+
+    assert(MACHINEID_ERROR_NULL_CONTEXT == machineid_ctx_generate(
+        NULL, buffer, MACHINEID_FLAG_DEFAULT));
+    assert(MACHINEID_ERROR_NULL_OUTPUT_BUFFER == machineid_ctx_generate(
+        &ctx, NULL, MACHINEID_FLAG_DEFAULT));
+}
+
+static void
+test_ctx_matches_global()
+{
+    struct machineid_ctx ctx;
+    unsigned char global[MACHINEID_HASH_SIZE], local[MACHINEID_HASH_SIZE];
+    enum machineid_error globalErr, localErr;
+
+    machineid_ctx_init(&ctx, 1);
+
+    globalErr = machineid_generate(global, MACHINEID_FLAG_DEFAULT);
+    localErr = machineid_ctx_generate(&ctx, local, MACHINEID_FLAG_DEFAULT);
+
+    assert(globalErr == localErr);
+
+    if (globalErr == MACHINEID_ERROR_NONE) {
+        assert(memcmp(global, local, MACHINEID_HASH_SIZE) == 0);
+    }
+}
+
+static void
+test_ctx_cached()
+{
+    struct machineid_ctx ctx;
+    unsigned char first[MACHINEID_UUID_SIZE + 1],
+        second[MACHINEID_UUID_SIZE + 1];
+    enum machineid_error firstErr, secondErr;
+
+    machineid_ctx_init(&ctx, 52);
+
+    firstErr = machineid_ctx_generate(&ctx, first, MACHINEID_FLAG_AS_UUID
+        | MACHINEID_FLAG_NULL_TERMINATE);
+    secondErr = machineid_ctx_generate(&ctx, second, MACHINEID_FLAG_AS_UUID
+        | MACHINEID_FLAG_NULL_TERMINATE);
+
+    assert(firstErr == secondErr);
+    assert(ctx.cached == 1);
+    assert(strcmp((const char *)first, (const char *)second) == 0);
+}
+
+/* the minimal profile only provides the identifier itself */
+#ifndef MACHINEID_MINIMAL
+static void
+test_fingerprint_generate()
+{
+    struct machineid_fingerprint first, second;
+    enum machineid_error err;
+    unsigned int i, present;
+
+    assert(MACHINEID_ERROR_NULL_OUTPUT_BUFFER ==
+        machineid_fingerprint_generate(NULL));
+
+    err = machineid_fingerprint_generate(&first);
+
+    assert(err == MACHINEID_ERROR_NONE
+        || err == MACHINEID_ERROR_NO_COMPONENTS);
+
+    machineid_fingerprint_generate(&second);
+
+    present = 0;
+
+    for (i = 0; i < MACHINEID_COMPONENT_COUNT; i++) {
+        present += (first.present >> i) & 1;
+    }
+
+    assert(machineid_fingerprint_match(&first, &second) == present);
+}
+
+static void
+test_fingerprint_match()
+{
+    struct machineid_fingerprint records[3];
+    unsigned char scores[3];
+
+    memset(records, 0, sizeof(records));
+
+    /* records[1] has a replaced disk, and no network component */
+    records[0].present = 0x1F;
+    records[1].present = 0x1B;
+    records[2].present = 0x1F;
+
+    memset(records[0].digests, 1, sizeof(records[0].digests));
+    memset(records[1].digests, 1, sizeof(records[1].digests));
+    memset(records[2].digests, 2, sizeof(records[2].digests));
+
+    records[1].digests[MACHINEID_COMPONENT_DISK_SERIAL][0] = 3;
+
+    assert(machineid_fingerprint_match(&records[0], &records[0]) == 5);
+    assert(machineid_fingerprint_match(&records[0], &records[1]) == 3);
+    assert(machineid_fingerprint_match(&records[1], &records[0]) == 3);
+    assert(machineid_fingerprint_match(&records[0], &records[2]) == 0);
+    assert(machineid_fingerprint_match(NULL, &records[0]) == 0);
+
+    assert(machineid_fingerprint_match_batch(&records[0], records, 3, 3,
+        scores) == 2);
+    assert(scores[0] == 5 && scores[1] == 3 && scores[2] == 0);
+    assert(machineid_fingerprint_match_batch(&records[0], records, 3, 4,
+        NULL) == 1);
+}
+
+static void
+test_token_known_answer()
+{
+    /* RFC 4231 test case 2, keys shorter than a block are zero padded */
+    static const unsigned char expected[MACHINEID_TOKEN_TAG_SIZE] = {
+        0x5b, 0xdc, 0xc1, 0x46, 0xbf, 0x60, 0x75, 0x4e,
+        0x6a, 0x04, 0x24, 0x26, 0x08, 0x95, 0x75, 0xc7
+    };
+    const char *const payload = "what do ya want for nothing?";
+    unsigned char key[MACHINEID_TOKEN_KEY_SIZE], token[64];
+    size_t payloadSize;
+
+    memset(key, 0, sizeof(key));
+    memcpy(key, "Jefe", 4);
+
+    payloadSize = strlen(payload);
+
+    assert(machineid_token_issue(token, key, (const unsigned char *)payload,
+        payloadSize) == MACHINEID_ERROR_NONE);
+    assert(memcmp(token, payload, payloadSize) == 0);
+    assert(memcmp(token + payloadSize, expected, sizeof(expected)) == 0);
+    assert(machineid_token_verify(key, token,
+        payloadSize + MACHINEID_TOKEN_TAG_SIZE) == 1);
+
+    token[0] ^= 1;
+
+    assert(machineid_token_verify(key, token,
+        payloadSize + MACHINEID_TOKEN_TAG_SIZE) == 0);
+    assert(machineid_token_verify(key, token,
+        MACHINEID_TOKEN_TAG_SIZE - 1) == 0);
+    assert(machineid_token_issue(NULL, key, token, 1)
+        == MACHINEID_ERROR_NULL_OUTPUT_BUFFER);
+    assert(machineid_token_issue(token, NULL, token, 1)
+        == MACHINEID_ERROR_NULL_INPUT_BUFFER);
+}
+
+static void
+test_token_verify_batch()
+{
+    unsigned char digest[MACHINEID_HASH_SIZE], keys[2][MACHINEID_TOKEN_KEY_SIZE],
+        payload[160], storage[24][160 + MACHINEID_TOKEN_TAG_SIZE], results[25];
+    struct machineid_token tokens[25];
+    size_t i, size, expected;
+
+    memset(digest, 7, sizeof(digest));
+
+    assert(machineid_token_key(keys[0], digest,
+        (const unsigned char *)"secret", 6) == MACHINEID_ERROR_NONE);
+    assert(machineid_token_key(keys[1], digest, NULL, 0)
+        == MACHINEID_ERROR_NONE);
+    assert(memcmp(keys[0], keys[1], MACHINEID_TOKEN_KEY_SIZE) != 0);
+    assert(machineid_token_key(keys[0], NULL, NULL, 0)
+        == MACHINEID_ERROR_NULL_INPUT_BUFFER);
+
+    for (i = 0; i < sizeof(payload); i++) {
+        payload[i] = (unsigned char)i;
+    }
+
+    expected = 0;
+
+    /* sizes cross the one and two block boundaries of the inner hash */
+    for (i = 0; i < 24; i++) {
+        size = (i * 37) % sizeof(payload);
+
+        machineid_token_issue(storage[i], keys[i % 2], payload, size);
+
+        if (i % 5 == 3) {
+            storage[i][size] ^= 0x80;
+        }
+
+        tokens[i].key = keys[i % 2];
+        tokens[i].data = storage[i];
+        tokens[i].size = size + MACHINEID_TOKEN_TAG_SIZE;
+
+        expected += machineid_token_verify(tokens[i].key, tokens[i].data,
+            tokens[i].size);
+    }
+
+    tokens[24].key = keys[0];
+    tokens[24].data = storage[0];
+    tokens[24].size = MACHINEID_TOKEN_TAG_SIZE - 1;
+
+    assert(expected == 24 - 5);
+    assert(machineid_token_verify_batch(tokens, 25, results) == expected);
+
+    for (i = 0; i < 24; i++) {
+        assert(results[i] == machineid_token_verify(tokens[i].key,
+            tokens[i].data, tokens[i].size));
+    }
+
+    assert(results[24] == 0);
+}
+
+#define TEST_PLACEMENT_KEYS 20000
+
+static void
+test_placement_digest(unsigned char *const digest, unsigned long i)
+{
+    unsigned int j;
+
+    /* an xorshift stream stands in for uniformly distributed digests */
+    i = i * 2654435761UL + 1;
+
+    for (j = 0; j < MACHINEID_HASH_SIZE; j++) {
+        i ^= (i << 13) & 0xFFFFFFFFUL;
+        i ^= i >> 17;
+        i ^= (i << 5) & 0xFFFFFFFFUL;
+        digest[j] = (unsigned char)(i >> 8);
+    }
+}
+
+/* every count must be within tolerance percent of its expected share */
+static void
+test_placement_uniform(const unsigned long *const counts,
+    const unsigned long *const expected, const unsigned long size,
+    const unsigned long tolerance)
+{
+    unsigned long i, difference;
+
+    for (i = 0; i < size; i++) {
+        difference = counts[i] > expected[i] ? counts[i] - expected[i]
+            : expected[i] - counts[i];
+
+        assert(difference * 100 <= expected[i] * tolerance);
+    }
+}
+
+static void
+test_placement_jump()
+{
+    unsigned char digest[MACHINEID_HASH_SIZE], digests[4][MACHINEID_HASH_SIZE];
+    unsigned long i, counts[10], expected[10], before, after, results[4];
+
+    memset(counts, 0, sizeof(counts));
+
+    for (i = 0; i < 10; i++) {
+        expected[i] = TEST_PLACEMENT_KEYS / 10;
+    }
+
+    for (i = 0; i < TEST_PLACEMENT_KEYS; i++) {
+        test_placement_digest(digest, i);
+
+        before = machineid_place_jump(digest, 10);
+        after = machineid_place_jump(digest, 11);
+
+        assert(before < 10);
+        assert(after == before || after == 10);
+
+        counts[before]++;
+    }
+
+    test_placement_uniform(counts, expected, 10, 5);
+
+    for (i = 0; i < 4; i++) {
+        test_placement_digest(digests[i], i);
+    }
+
+    machineid_place_jump_batch(digests[0], 4, 7, results);
+
+    for (i = 0; i < 4; i++) {
+        assert(results[i] == machineid_place_jump(digests[i], 7));
+    }
+
+    assert(machineid_place_jump(digest, 0) == 0);
+    assert(machineid_place_jump(digest, 1) == 0);
+}
+
+static void
+test_placement_rendezvous()
+{
+    struct machineid_bucket buckets[4];
+    unsigned char digest[MACHINEID_HASH_SIZE], digests[4][MACHINEID_HASH_SIZE];
+    unsigned long i, counts[4], expected[4];
+    size_t all, without, results[4];
+
+    buckets[0].id = 100;
+    buckets[0].weight = 1;
+    buckets[1].id = 200;
+    buckets[1].weight = 2;
+    buckets[2].id = 300;
+    buckets[2].weight = 1;
+    buckets[3].id = 400;
+    buckets[3].weight = 0;
+
+    memset(counts, 0, sizeof(counts));
+
+    expected[0] = TEST_PLACEMENT_KEYS / 4;
+    expected[1] = TEST_PLACEMENT_KEYS / 2;
+    expected[2] = TEST_PLACEMENT_KEYS / 4;
+    expected[3] = 0;
+
+    for (i = 0; i < TEST_PLACEMENT_KEYS; i++) {
+        test_placement_digest(digest, i);
+
+        all = machineid_place_rendezvous(digest, buckets, 4);
+
+        assert(all < 3);
+
+        /* removing the last live bucket only moves the keys it held */
+        without = machineid_place_rendezvous(digest, buckets, 2);
+
+        assert(all == 2 || without == all);
+
+        counts[all]++;
+    }
+
+    test_placement_uniform(counts, expected, 4, 5);
+
+    /* equal weights take a separate path, check it is uniform as well */
+    buckets[1].weight = 1;
+
+    memset(counts, 0, sizeof(counts));
+
+    for (i = 0; i < TEST_PLACEMENT_KEYS; i++) {
+        test_placement_digest(digest, i);
+
+        counts[machineid_place_rendezvous(digest, buckets, 3)]++;
+    }
+
+    expected[0] = expected[1] = expected[2] = TEST_PLACEMENT_KEYS / 3;
+
+    test_placement_uniform(counts, expected, 3, 5);
+
+    for (i = 0; i < 4; i++) {
+        test_placement_digest(digests[i], i);
+    }
+
+    machineid_place_rendezvous_batch(digests[0], 4, buckets, 4, results);
+
+    for (i = 0; i < 4; i++) {
+        assert(results[i] == machineid_place_rendezvous(digests[i],
+            buckets, 4));
+    }
+
+    buckets[0].weight = 0;
+
+    assert(machineid_place_rendezvous(digest, buckets, 1) == 1);
+    assert(machineid_place_rendezvous(digest, buckets, 0) == 0);
+}
+
+static void
+test_placement_cohort()
+{
+    unsigned char digest[MACHINEID_HASH_SIZE], digests[4][MACHINEID_HASH_SIZE];
+    unsigned long i, counts[20], expected[20], same, results[4], huge;
+
+    memset(counts, 0, sizeof(counts));
+
+    for (i = 0; i < 20; i++) {
+        expected[i] = TEST_PLACEMENT_KEYS / 20;
+    }
+
+    same = 0;
+
+    for (i = 0; i < TEST_PLACEMENT_KEYS; i++) {
+        test_placement_digest(digest, i);
+
+        counts[machineid_place_cohort(digest, 1, 20)]++;
+
+        same += machineid_place_cohort(digest, 1, 20)
+            == machineid_place_cohort(digest, 2, 20);
+    }
+
+    test_placement_uniform(counts, expected, 20, 10);
+
+    /* different salts should be independent, sharing one in 20 cohorts */
+    assert(same * 100 <= TEST_PLACEMENT_KEYS * 7);
+
+    for (i = 0; i < 4; i++) {
+        test_placement_digest(digests[i], i);
+    }
+
+    machineid_place_cohort_batch(digests[0], 4, 3, 100, results);
+
+    for (i = 0; i < 4; i++) {
+        assert(results[i] == machineid_place_cohort(digests[i], 3, 100));
+    }
+
+    /* counts of 2^32 and above must not wrap, checked where long is wider */
+    huge = (0xFFFFFFFFUL << 16) << 16;
+
+    if (huge != 0) {
+        same = 0;
+
+        for (i = 0; i < TEST_PLACEMENT_KEYS; i++) {
+            test_placement_digest(digest, i);
+
+            assert(machineid_place_cohort(digest, 1, huge + 5) < huge + 5);
+            same += machineid_place_cohort(digest, 1, huge + 5) > 0xFFFFFFFFUL;
+        }
+
+        assert(same * 10 >= TEST_PLACEMENT_KEYS * 9);
+    }
+}
+
+static void
+test_backend_select()
+{
+    struct machineid_ctx ctx;
+    unsigned char vendored[MACHINEID_HASH_SIZE], other[MACHINEID_HASH_SIZE];
+    enum machineid_error vendoredErr, otherErr;
+    int backend;
+
+    assert(machineid_backend_available(MACHINEID_BACKEND_VENDORED));
+    assert(!machineid_backend_available(MACHINEID_BACKEND_AUTO));
+    assert(!machineid_backend_available(MACHINEID_BACKEND_COUNT));
+
+    assert(machineid_backend_select(MACHINEID_BACKEND_COUNT)
+        == MACHINEID_ERROR_BACKEND_UNAVAILABLE);
+
+    assert(machineid_backend_select(MACHINEID_BACKEND_VENDORED)
+        == MACHINEID_ERROR_NONE);
+    assert(machineid_backend_get() == MACHINEID_BACKEND_VENDORED);
+
+    machineid_ctx_init(&ctx, 1);
+    vendoredErr = machineid_ctx_generate(&ctx, vendored,
+        MACHINEID_FLAG_DEFAULT);
+
+    /* every backend that passed its self test must hash identically */
+    for (backend = MACHINEID_BACKEND_OPENSSL;
+        backend < MACHINEID_BACKEND_COUNT; backend++) {
+        if (!machineid_backend_available(backend)) {
+            assert(machineid_backend_select(backend)
+                == MACHINEID_ERROR_BACKEND_UNAVAILABLE);
+            assert(machineid_backend_get() == MACHINEID_BACKEND_VENDORED);
+
+            continue;
+        }
+
+        assert(machineid_backend_select(backend) == MACHINEID_ERROR_NONE);
+        assert(machineid_backend_get() == (enum machineid_backend)backend);
+
+        machineid_ctx_init(&ctx, 1);
+        otherErr = machineid_ctx_generate(&ctx, other,
+            MACHINEID_FLAG_DEFAULT);
+
+        if (vendoredErr == MACHINEID_ERROR_NONE) {
+            assert(otherErr == MACHINEID_ERROR_NONE);
+            assert(memcmp(vendored, other, MACHINEID_HASH_SIZE) == 0);
+        }
+    }
+
+    assert(machineid_backend_select(MACHINEID_BACKEND_AUTO)
+        == MACHINEID_ERROR_NONE);
+    assert(machineid_backend_available(machineid_backend_get()));
+
+    assert(strcmp("MACHINEID_BACKEND_VENDORED",
+        machineid_backend_to_string(MACHINEID_BACKEND_VENDORED)) == 0);
+    assert(machineid_backend_to_string(52) == NULL);
+}
+
+/*
+ * RFC 8439 section 2.3.2, and appendix A.1 test vector 1 which has the zero
+ * nonce the random UUID streams use
+ */
+static void
+test_chacha20_known_answer()
+{
+    static const unsigned char block[CHACHA20_BLOCK_SIZE] = {
+        0x10, 0xf1, 0xe7, 0xe4, 0xd1, 0x3b, 0x59, 0x15,
+        0x50, 0x0f, 0xdd, 0x1f, 0xa3, 0x20, 0x71, 0xc4,
+        0xc7, 0xd1, 0xf4, 0xc7, 0x33, 0xc0, 0x68, 0x03,
+        0x04, 0x22, 0xaa, 0x9a, 0xc3, 0xd4, 0x6c, 0x4e,
+        0xd2, 0x82, 0x64, 0x46, 0x07, 0x9f, 0xaa, 0x09,
+        0x14, 0xc2, 0xd7, 0x05, 0xd9, 0x8b, 0x02, 0xa2,
+        0xb5, 0x12, 0x9c, 0xd1, 0xde, 0x16, 0x4e, 0xb9,
+        0xcb, 0xd0, 0x83, 0xe8, 0xa2, 0x50, 0x3c, 0x4e
+    };
+    static const unsigned char zero[CHACHA20_BLOCK_SIZE] = {
+        0x76, 0xb8, 0xe0, 0xad, 0xa0, 0xf1, 0x3d, 0x90,
+        0x40, 0x5d, 0x6a, 0xe5, 0x53, 0x86, 0xbd, 0x28,
+        0xbd, 0xd2, 0x19, 0xb8, 0xa0, 0x8d, 0xed, 0x1a,
+        0xa8, 0x36, 0xef, 0xcc, 0x8b, 0x77, 0x0d, 0xc7,
+        0xda, 0x41, 0x59, 0x7c, 0x51, 0x57, 0x48, 0x8d,
+        0x77, 0x24, 0xe0, 0x3f, 0xb8, 0xd8, 0x4a, 0x37,
+        0x6a, 0x43, 0xb8, 0xf4, 0x15, 0x18, 0xa1, 0x1c,
+        0xc3, 0x87, 0xb6, 0x69, 0xb2, 0xee, 0x65, 0x86
+    };
+    static const unsigned char nonceBytes[12] = {
+        0x00, 0x00, 0x00, 0x09, 0x00, 0x00, 0x00, 0x4a,
+        0x00, 0x00, 0x00, 0x00
+    };
+    unsigned char keyBytes[32], output[CHACHA20_BLOCK_SIZE];
+    uint32_t key[8], nonce[3];
+    unsigned int i;
+
+    for (i = 0; i < sizeof(keyBytes); i++) {
+        keyBytes[i] = (unsigned char)i;
+    }
+
+    for (i = 0; i < 8; i++) {
+        key[i] = chacha20_load32(keyBytes + i * 4);
+    }
+
+    for (i = 0; i < 3; i++) {
+        nonce[i] = chacha20_load32(nonceBytes + i * 4);
+    }
+
+    chacha20_block(output, key, 1, nonce);
+    assert(memcmp(output, block, sizeof(output)) == 0);
+
+    memset(key, 0, sizeof(key));
+    memset(nonce, 0, sizeof(nonce));
+
+    chacha20_block(output, key, 0, nonce);
+    assert(memcmp(output, zero, sizeof(output)) == 0);
+}
+
+#define TEST_RANDOM_UUIDS 1000
+
+static int
+test_random_uuid_compare(const void *a, const void *b)
+{
+    return memcmp(a, b, MACHINEID_UUID_SIZE);
+}
+
+static void
+test_random_uuid_fill()
+{
+    unsigned char *uuids, *uuid, single[MACHINEID_UUID_SIZE + 1];
+    size_t i, j;
+
+    assert(machineid_random_uuid_fill(NULL, 1)
+        == MACHINEID_ERROR_NULL_OUTPUT_BUFFER);
+    assert(machineid_random_uuid_fill(single, 0) == MACHINEID_ERROR_NONE);
+
+    uuids = malloc(TEST_RANDOM_UUIDS * MACHINEID_UUID_SIZE);
+    assert(uuids != NULL);
+
+    assert(machineid_random_uuid_fill(uuids, TEST_RANDOM_UUIDS)
+        == MACHINEID_ERROR_NONE);
+
+    for (i = 0; i < TEST_RANDOM_UUIDS; i++) {
+        uuid = uuids + i * MACHINEID_UUID_SIZE;
+
+        for (j = 0; j < MACHINEID_UUID_SIZE; j++) {
+            if (j == 8 || j == 13 || j == 18 || j == 23) {
+                assert(uuid[j] == '-');
+            } else {
+                assert(strchr("0123456789abcdef", uuid[j]) != NULL);
+            }
+        }
+
+        assert(uuid[14] == '4');
+        assert(strchr("89ab", uuid[19]) != NULL);
+    }
+
+    /* spans several refills, any repeat means the stream is reused */
+    qsort(uuids, TEST_RANDOM_UUIDS, MACHINEID_UUID_SIZE,
+        test_random_uuid_compare);
+
+    for (i = 1; i < TEST_RANDOM_UUIDS; i++) {
+        assert(memcmp(uuids + (i - 1) * MACHINEID_UUID_SIZE,
+            uuids + i * MACHINEID_UUID_SIZE, MACHINEID_UUID_SIZE) != 0);
+    }
+
+    free(uuids);
+
+    memset(single, 0, sizeof(single));
+    assert(machineid_random_uuid_fill(single, 1) == MACHINEID_ERROR_NONE);
+    assert(single[MACHINEID_UUID_SIZE] == 0);
+}
+
+#ifndef _WIN32
+/* a child continuing the parent stream would repeat the parents next UUID */
+static void
+test_random_uuid_fork()
+{
+    unsigned char parent[MACHINEID_UUID_SIZE], child[MACHINEID_UUID_SIZE];
+    int fds[2], status;
+    pid_t pid;
+
+    assert(machineid_random_uuid_fill(parent, 1) == MACHINEID_ERROR_NONE);
+    assert(pipe(fds) == 0);
+
+    pid = fork();
+    assert(pid >= 0);
+
+    if (pid == 0) {
+        close(fds[0]);
+
+        if (machineid_random_uuid_fill(child, 1) != MACHINEID_ERROR_NONE
+            || write(fds[1], child, sizeof(child)) != sizeof(child)) {
+            _exit(1);
+        }
+
+        _exit(0);
+    }
+
+    close(fds[1]);
+
+    assert(read(fds[0], child, sizeof(child)) == sizeof(child));
+    assert(waitpid(pid, &status, 0) == pid);
+    assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+    close(fds[0]);
+
+    assert(machineid_random_uuid_fill(parent, 1) == MACHINEID_ERROR_NONE);
+    assert(memcmp(parent, child, MACHINEID_UUID_SIZE) != 0);
+}
+
+/*
+ * Forks while the prefetch is most likely still running, the child must not
+ * wait for a thread that does not exist in it. A hang is ended by the alarm.
+ */
+static void
+test_prefetch_fork()
+{
+    unsigned char parent[MACHINEID_HASH_SIZE], child[MACHINEID_HASH_SIZE];
+    enum machineid_error parentErr;
+    int fds[2], status;
+    pid_t pid;
+
+    assert(pipe(fds) == 0);
+    assert(machineid_prefetch() == MACHINEID_ERROR_NONE);
+
+    pid = fork();
+    assert(pid >= 0);
+
+    if (pid == 0) {
+        close(fds[0]);
+        alarm(5);
+
+        machineid_generate(child, MACHINEID_FLAG_DEFAULT);
+
+        if (write(fds[1], child, sizeof(child)) != sizeof(child)) {
+            _exit(1);
+        }
+
+        _exit(0);
+    }
+
+    close(fds[1]);
+
+    assert(read(fds[0], child, sizeof(child)) == sizeof(child));
+    assert(waitpid(pid, &status, 0) == pid);
+    assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+    close(fds[0]);
+
+    parentErr = machineid_generate(parent, MACHINEID_FLAG_DEFAULT);
+
+    if (parentErr == MACHINEID_ERROR_NONE) {
+        assert(memcmp(parent, child, MACHINEID_HASH_SIZE) == 0);
+    }
+}
+#endif
+
+#endif
+
+/*
+ * must run after every test expecting a cold process wide result, as it
+ * warms it
+ */
+static void
+test_prefetch()
+{
+    struct machineid_ctx ctx;
+    struct machineid_stats before, after;
+    unsigned char first[MACHINEID_HASH_SIZE], second[MACHINEID_HASH_SIZE],
+        local[MACHINEID_HASH_SIZE];
+    enum machineid_error firstErr, secondErr, localErr;
+
+    machineid_stats_get(&before);
+
+    assert(machineid_prefetch() == MACHINEID_ERROR_NONE);
+    assert(machineid_prefetch() == MACHINEID_ERROR_NONE);
+
+    firstErr = machineid_generate(first, MACHINEID_FLAG_DEFAULT);
+    secondErr = machineid_generate(second, MACHINEID_FLAG_DEFAULT);
+
+    assert(firstErr == secondErr);
+    assert(memcmp(first, second, MACHINEID_HASH_SIZE) == 0);
+
+    machineid_ctx_init(&ctx, 1);
+
+    localErr = machineid_ctx_generate(&ctx, local, MACHINEID_FLAG_DEFAULT);
+
+    if (localErr == MACHINEID_ERROR_NONE) {
+        assert(firstErr == MACHINEID_ERROR_NONE);
+        assert(memcmp(first, local, MACHINEID_HASH_SIZE) == 0);
+    }
+
+    machineid_stats_get(&after);
+
+    assert(after.prefetches <= 1);
+    /* only the first served call is counted, later ones skip the lock */
+    assert(after.prefetchHits == (before.prefetchHits != 0
+        ? before.prefetchHits : 1));
+    assert(after.waitMicroseconds >= before.waitMicroseconds);
+}
+
 int
 main()
 {
@@ -103,10 +876,31 @@ main()
     unsigned char buffer[MACHINEID_UUID_SIZE + 1];
 
     test_error_string_encoding();
+    test_sha256_known_answer();
     test_null_output_buffer();
     test_null_terminate_hash();
     test_null_terminate_uuid();
     test_uuid_not_terminated();
+    test_ctx_null();
+    test_ctx_matches_global();
+    test_ctx_cached();
+#ifndef MACHINEID_MINIMAL
+    test_fingerprint_generate();
+    test_fingerprint_match();
+    test_token_known_answer();
+    test_token_verify_batch();
+    test_placement_jump();
+    test_placement_rendezvous();
+    test_placement_cohort();
+    test_backend_select();
+    test_chacha20_known_answer();
+    test_random_uuid_fill();
+#ifndef _WIN32
+    test_random_uuid_fork();
+    test_prefetch_fork();
+#endif
+#endif
+    test_prefetch();
 
     err = machineid_generate(buffer, MACHINEID_FLAG_AS_UUID
         | MACHINEID_FLAG_NULL_TERMINATE);